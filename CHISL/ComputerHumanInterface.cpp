@@ -1,6 +1,8 @@
 #include <iostream>
 #include <Windows.h>
+#include <Psapi.h>
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -14,6 +16,13 @@
 #include <thread>
 #include <format>
 #include <cstdlib>
+#include <cstring>
+#include <array>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <deque>
 #include <tesseract/baseapi.h>
 #include <leptonica/allheaders.h>
 
@@ -51,11 +60,46 @@ typedef WORD CHISL_KEY;
 
 constexpr CHISL_NUMBER DEFAULT_THRESHOLD = 0.5f;
 constexpr DWORD DEFAULT_TYPING_DELAY = 0;
+constexpr CHISL_NUMBER DEFAULT_TEXT_HEIGHT = 24.0; // glyph height, in pixels, that text is scaled to before reading
+constexpr CHISL_NUMBER MIN_READING_SCALE = 1.0;
+constexpr CHISL_NUMBER MAX_READING_SCALE = 4.0;
+constexpr CHISL_NUMBER TEXT_REGION_MIN_EDGE = 32.0; // minimum edge strength for text regions
+constexpr int TEXT_REGION_PADDING = 4;
+constexpr CHISL_NUMBER TEXT_REGION_MAX_COVERAGE = 0.5; // fraction of the image past which text regions are not used
+#define DEFAULT_TEXT_PROFILE "default"
+#define DEFAULT_TEXT_MODEL "tessdata"
+constexpr CHISL_NUMBER GLYPH_THRESHOLD = 0.8; // minimum match for a glyph to be read
+constexpr int GLYPH_PADDING = 1; // background, in pixels, kept around each learned glyph
+constexpr CHISL_NUMBER GLYPH_SPLIT_GAP = 0.5; // fraction of the median gap between glyphs below which a gap is within a glyph
+constexpr int GLYPH_SLACK = 2; // pixels that a glyph being read can differ in size from the learned glyph
+constexpr int MIN_PYRAMID_TEMPLATE_SIZE = 8; // smallest a template is shrunk to for a coarse search
+constexpr uint64_t EXACT_ROW_BASE = 0x100000001B3ull; // multipliers for the rolling hashes of exact searches, must be odd
+constexpr uint64_t EXACT_COLUMN_BASE = 0x9E3779B97F4A7C15ull;
+constexpr int MATCH_TILE_SIZE = 256; // least width and height of the scores each thread works out while finding
+constexpr CHISL_NUMBER SCALE_PRUNE_MARGIN = 0.1; // how far below the best score so far a scale's coarse score can be and still be searched at full size
+constexpr int FEATURE_TEMPLATE_POINTS = 1000; // most keypoints found within a template
+constexpr int FEATURE_IMAGE_POINTS = 10000; // most keypoints found within an image that templates are found in
+constexpr int FEATURE_MIN_MATCHES = 8; // least keypoints that must agree on where a template is
+constexpr CHISL_NUMBER FEATURE_RATIO = 0.75; // most the best match of a keypoint can score compared to the second best, to be sure of it
+constexpr CHISL_NUMBER FEATURE_REPROJECTION_ERROR = 5.0; // furthest, in pixels, a keypoint can be from where the template puts it and still agree
+constexpr CHISL_NUMBER NEARBY_MIN_SCORE = 0.9; // least score a match near where the template was last found needs, to be taken without searching the whole image
+constexpr size_t IMAGE_LIBRARY_MAX_BYTES = 256 * 1024 * 1024; // most bytes of pixels kept for loaded images, past which the least recently loaded are let go
+constexpr size_t FIND_COLOR_MAX_MATCHES = 100000; // most pixels Find all color keeps, since each is its own match
+
+// BT.601 luminance weights, out of 256
+constexpr int LUMA_WEIGHT_B = 29;
+constexpr int LUMA_WEIGHT_G = 150;
+constexpr int LUMA_WEIGHT_R = 77;
 
 #define CONSTANT_OUTPUT "OUTPUT"
 #define CONSTANT_RESULT "RESULT"
 #define CONSTANT_PASS_COUNT "PASS_COUNT"
 #define CONSTANT_FAIL_COUNT "FAIL_COUNT"
+#define CONSTANT_TIME "TIME"
+#define CONSTANT_MEMORY "MEMORY"
+#define CONSTANT_NEARBY_HITS "NEARBY_HITS"
+#define CONSTANT_NEARBY_MISSES "NEARBY_MISSES"
+#define CONSTANT_PREFILTER_SKIPPED "PREFILTER_SKIPPED"
 #define CONSTANT_TRUE "true"
 #define CONSTANT_FALSE "false"
 
@@ -65,6 +109,11 @@ static std::unordered_set<CHISL_STRING> CONSTANTS_NAMES =
 	CONSTANT_RESULT,
 	CONSTANT_PASS_COUNT,
 	CONSTANT_FAIL_COUNT,
+	CONSTANT_TIME,
+	CONSTANT_MEMORY,
+	CONSTANT_NEARBY_HITS,
+	CONSTANT_NEARBY_MISSES,
+	CONSTANT_PREFILTER_SKIPPED,
 	CONSTANT_TRUE,
 	CONSTANT_FALSE
 };
@@ -86,6 +135,19 @@ CHISL_STRING get_path()
 	return "";
 }
 
+// Gets the memory used by the process, in megabytes.
+CHISL_NUMBER get_memory_usage()
+{
+	PROCESS_MEMORY_COUNTERS counters;
+
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return 0.0;
+	}
+
+	return static_cast<CHISL_NUMBER>(counters.WorkingSetSize) / (1024.0 * 1024.0);
+}
+
 // Converts the given string into lower case characters.
 CHISL_STRING string_to_lower(CHISL_STRING str)
 {
@@ -279,7 +341,8 @@ CHISL_STRING key_to_string(const WORD key)
 
 bool string_to_bool(const CHISL_STRING& str)
 {
-	return str.compare("off");
+	// false constant is evaluated to 0 when given as a variable
+	return str != "off" && str != "false" && str != "0";
 }
 
 /// <summary>
@@ -401,21 +464,329 @@ tesseract::PageIteratorLevel string_to_pil(CHISL_STRING const& str)
 #define TEXT_ITALIC "\033[3m"
 #define TEXT_UNDERLINE "\033[4"
 
+/// <summary>
+/// Holds the settings an OCR engine is created with.
+/// </summary>
+struct TextProfile
+{
+	// the only characters that can be read, or empty for all characters
+	CHISL_STRING whitelist;
+	// how the engine splits the image into text
+	tesseract::PageSegMode mode = tesseract::PSM_SPARSE_TEXT;
+	// the folder within the CHISL path that holds the model
+	CHISL_STRING model = DEFAULT_TEXT_MODEL;
+	// the resolution the engine assumes the image is at
+	int dpi = 71;
+};
+
+/// <summary>
+/// Gets the text profile with the given name.
+/// </summary>
+/// <param name="name"></param>
+/// <returns>The profile, or nothing if no profile has that name.</returns>
+std::optional<TextProfile> get_text_profile(CHISL_STRING const& name)
+{
+	static std::unordered_map<CHISL_STRING, TextProfile> profiles =
+	{
+		{ DEFAULT_TEXT_PROFILE, TextProfile{ "", tesseract::PSM_SPARSE_TEXT, DEFAULT_TEXT_MODEL } },
+		{ "fast", TextProfile{ "", tesseract::PSM_SPARSE_TEXT, "tessdata_fast" } },
+		{ "best", TextProfile{ "", tesseract::PSM_SPARSE_TEXT, "tessdata_best" } },
+		{ "digits", TextProfile{ "0123456789.,:+-", tesseract::PSM_SINGLE_LINE, "tessdata_fast" } },
+		{ "block", TextProfile{ "", tesseract::PSM_SINGLE_BLOCK, DEFAULT_TEXT_MODEL } },
+		{ "line", TextProfile{ "", tesseract::PSM_SINGLE_LINE, DEFAULT_TEXT_MODEL } },
+		{ "word", TextProfile{ "", tesseract::PSM_SINGLE_WORD, DEFAULT_TEXT_MODEL } },
+	};
+
+	auto found = profiles.find(string_to_lower(name));
+
+	if (found == profiles.end())
+	{
+		return std::nullopt;
+	}
+
+	return found->second;
+}
+
+/// <summary>
+/// Holds the templates for each character of a fixed font, learned from a sample image.
+/// </summary>
+struct GlyphSet
+{
+	// the character of each template
+	CHISL_STRING characters;
+	// the grayscale template of each character
+	std::vector<CHISL_MATRIX> glyphs;
+	// the gap between glyphs, in pixels, past which a space is read
+	int spaceWidth = 0;
+	// the height of the tallest glyph
+	int height = 0;
+};
+
+/// <summary>
+/// Holds the glyph sets that have been learned, by name.
+/// </summary>
+class GlyphSetLibrary
+{
+private:
+	std::mutex m_mutex;
+	std::unordered_map<CHISL_STRING, std::shared_ptr<GlyphSet const>> m_sets;
+
+public:
+	void set(CHISL_STRING const& name, GlyphSet const& glyphSet)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_sets[string_to_lower(name)] = std::make_shared<GlyphSet const>(glyphSet);
+	}
+
+	std::shared_ptr<GlyphSet const> get(CHISL_STRING const& name)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto found = m_sets.find(string_to_lower(name));
+		if (found == m_sets.end())
+		{
+			return nullptr;
+		}
+
+		return found->second;
+	}
+
+	static GlyphSetLibrary& get_instance()
+	{
+		static GlyphSetLibrary library;
+		return library;
+	}
+};
+
+/// <summary>
+/// Holds settings for preparing an image to have its text read.
+/// </summary>
+struct ReadOptions
+{
+	// the scale to resize the image by, or 0 to pick one based on the height of the text
+	CHISL_NUMBER scale = 0.0;
+	// the glyph height, in pixels, that the automatic scale aims for
+	CHISL_NUMBER textHeight = DEFAULT_TEXT_HEIGHT;
+	// if true, the image is converted to black and white before being read
+	bool binarize = false;
+	// if true, the image is converted, resized and thresholded in a single pass
+	bool fused = true;
+	// if true, only the regions of the image that look like text are read
+	bool regions = true;
+	// the name of the text profile to read with
+	CHISL_STRING profile = DEFAULT_TEXT_PROFILE;
+	// the number of engines kept loaded for the profile
+	int engines = 1;
+};
+
+/// <summary>
+/// The channels of an image that are used when finding a template within it.
+/// </summary>
+enum class ColorMode
+{
+	Color,
+	Gray,
+	Blue,
+	Green,
+	Red,
+};
+
+/// <summary>
+/// Parses the given string into a color mode.
+/// </summary>
+/// <param name="str"></param>
+/// <returns>The color mode, or nothing if the string is not one.</returns>
+std::optional<ColorMode> string_to_color_mode(CHISL_STRING const& str)
+{
+	CHISL_STRING lower = string_to_lower(str);
+
+	if (lower == "color") return ColorMode::Color;
+	else if (lower == "gray") return ColorMode::Gray;
+	else if (lower == "blue") return ColorMode::Blue;
+	else if (lower == "green") return ColorMode::Green;
+	else if (lower == "red") return ColorMode::Red;
+
+	return std::nullopt;
+}
+
+/// <summary>
+/// The way a template is compared against an image when finding it.
+/// </summary>
+enum class FindMethod
+{
+	// normalized correlation, which allows for small differences in color and lighting
+	Correlation,
+	// pixel for pixel, which only finds identical copies of the template
+	Exact,
+	// the sum of the absolute differences between the pixels
+	Absolute,
+	// the sum of the squared differences between the pixels
+	Squared,
+	// keypoints matched between the images, which allows for any scale
+	Features,
+};
+
+/// <summary>
+/// Parses the given string into a find method.
+/// </summary>
+/// <param name="str"></param>
+/// <returns>The find method, or nothing if the string is not one.</returns>
+std::optional<FindMethod> string_to_find_method(CHISL_STRING const& str)
+{
+	CHISL_STRING lower = string_to_lower(str);
+
+	if (lower == "correlation") return FindMethod::Correlation;
+	else if (lower == "exact") return FindMethod::Exact;
+	else if (lower == "absolute") return FindMethod::Absolute;
+	else if (lower == "squared") return FindMethod::Squared;
+	else if (lower == "features") return FindMethod::Features;
+
+	return std::nullopt;
+}
+
+/// <summary>
+/// Holds settings for finding a template image within an image.
+/// </summary>
+struct FindOptions
+{
+	// the channels of the images that are matched
+	ColorMode color = ColorMode::Color;
+	// how the template is compared against the image
+	FindMethod method = FindMethod::Correlation;
+	// the number of times the image is halved for a coarse search first, or 0 to only search at full size
+	int pyramid = 0;
+	// the number of best spots from the coarse search that are searched again at full size
+	int candidates = 4;
+	// the most two matches from Find all may overlap, as their intersection over their union, before the worse one is dropped
+	CHISL_NUMBER overlap = 0.3;
+	// the least distance, in pixels, between the centers of two matches from Find all
+	CHISL_NUMBER distance = 0.0;
+	// the number of threads that search at once, or 0 to use every core
+	int threads = 0;
+	// how far, in pixels, around the last match of a template Find searches before searching the whole image, or 0 to always search the whole image
+	int nearby = 0;
+	// the smallest and largest sizes the template is searched at, as a multiple of its own size
+	CHISL_NUMBER scaleMin = 1.0;
+	CHISL_NUMBER scaleMax = 1.0;
+	// how much the size of the template changes between each scale that is searched
+	CHISL_NUMBER scaleStep = 0.05;
+	// how far, from 0 to 255, the mean of each channel of a spot can be from the template's before the spot is ruled out, or 0 to search every spot
+	CHISL_NUMBER prefilter = 0.0;
+};
+
 struct Config
 {
 	bool echo = false;
 	WORD quitKey = VK_ESCAPE;
+	ReadOptions read;
+	FindOptions find;
 
 	int set(CHISL_STRING const& name, CHISL_STRING const& value)
 	{
 		if (name == "echo")
 		{
-			echo = value != "false";
+			echo = string_to_bool(value);
 		}
 		else if (name == "quitKey")
 		{
 			quitKey = string_to_key(value);
 		}
+		else if (name == "readScale")
+		{
+			read.scale = std::max(parse_double(value), 0.0);
+		}
+		else if (name == "readTextHeight")
+		{
+			read.textHeight = std::max(parse_double(value), 1.0);
+		}
+		else if (name == "readBinarize")
+		{
+			read.binarize = string_to_bool(value);
+		}
+		else if (name == "readFused")
+		{
+			read.fused = string_to_bool(value);
+		}
+		else if (name == "readRegions")
+		{
+			read.regions = string_to_bool(value);
+		}
+		else if (name == "textProfile")
+		{
+			if (!get_text_profile(value).has_value() && !GlyphSetLibrary::get_instance().get(value))
+			{
+				std::cerr << "Unknown text profile \"" << value << "\".\n";
+				return 2;
+			}
+
+			read.profile = string_to_lower(value);
+		}
+		else if (name == "findColor")
+		{
+			std::optional<ColorMode> mode = string_to_color_mode(value);
+			if (!mode.has_value())
+			{
+				std::cerr << "Unknown color mode \"" << value << "\".\n";
+				return 2;
+			}
+
+			find.color = mode.value();
+		}
+		else if (name == "findMethod")
+		{
+			std::optional<FindMethod> method = string_to_find_method(value);
+			if (!method.has_value())
+			{
+				std::cerr << "Unknown find method \"" << value << "\".\n";
+				return 2;
+			}
+
+			find.method = method.value();
+		}
+		else if (name == "findPyramid")
+		{
+			find.pyramid = std::max(static_cast<int>(parse_double(value)), 0);
+		}
+		else if (name == "findCandidates")
+		{
+			find.candidates = std::max(static_cast<int>(parse_double(value)), 1);
+		}
+		else if (name == "findThreads")
+		{
+			find.threads = std::max(static_cast<int>(parse_double(value)), 0);
+		}
+		else if (name == "findNearby")
+		{
+			find.nearby = std::max(static_cast<int>(parse_double(value)), 0);
+		}
+		else if (name == "findOverlap")
+		{
+			find.overlap = std::clamp(parse_double(value), 0.0, 1.0);
+		}
+		else if (name == "findDistance")
+		{
+			find.distance = std::max(parse_double(value), 0.0);
+		}
+		else if (name == "findScaleMin")
+		{
+			find.scaleMin = std::max(parse_double(value), 0.1);
+		}
+		else if (name == "findScaleMax")
+		{
+			find.scaleMax = std::max(parse_double(value), 0.1);
+		}
+		else if (name == "findScaleStep")
+		{
+			find.scaleStep = std::max(parse_double(value), 0.01);
+		}
+		else if (name == "findPrefilter")
+		{
+			find.prefilter = std::clamp(parse_double(value), 0.0, 255.0);
+		}
+		else if (name == "textEngines")
+		{
+			read.engines = std::max(static_cast<int>(parse_double(value)), 1);
+		}
 		else
 		{
 			// no config with name found
@@ -426,6 +797,38 @@ struct Config
 	}
 };
 
+/// <summary>
+/// Holds the keypoints found within an image, and the descriptor of each.
+/// </summary>
+struct ImageFeatures
+{
+	std::vector<cv::KeyPoint> keypoints;
+	CHISL_MATRIX descriptors;
+};
+
+/// <summary>
+/// Holds the images worked out from an Image, so they are only worked out once.
+/// </summary>
+struct ImageCache
+{
+	std::mutex mutex;
+	std::unordered_map<int, CHISL_MATRIX> views;
+	// the sum and norm of each view, by the same key
+	std::unordered_map<int, std::pair<CHISL_NUMBER, CHISL_NUMBER>> statistics;
+	// where the image was last found, when it is used as a template, by the size of the whole image it was found within, relative to that whole image
+	std::unordered_map<int, CHISL_POINT> lastMatches;
+	// copies of the image resized by each scale, in thousandths, each with a cache of its own
+	std::unordered_map<int, std::pair<CHISL_MATRIX, std::shared_ptr<ImageCache>>> scaled;
+	// the scale the image was last found at, when it is used as a template, by the size of the whole image it was found within
+	std::unordered_map<int, CHISL_NUMBER> foundScales;
+	// the keypoints of each view
+	std::unordered_map<int, std::shared_ptr<ImageFeatures const>> features;
+	// how many commands running in the background are still reading the pixels
+	int readers = 0;
+	// if true, the pixels are those of a loaded file, which every load of the file shares
+	bool fromLibrary = false;
+};
+
 /// <summary>
 /// Holds data for an image.
 /// </summary>
@@ -433,6 +836,80 @@ class Image
 {
 private:
 	CHISL_MATRIX m_image;
+	// shared by copies, since they share the same pixels
+	std::shared_ptr<ImageCache> m_cache = std::make_shared<ImageCache>();
+	// the image this is an area of, and where, so what was worked out for the whole image is reused
+	std::shared_ptr<Image const> m_parent;
+	cv::Rect m_area;
+
+	// what is held in the cache for a view
+	enum ViewKind
+	{
+		VIEW_PIXELS = 0,
+		VIEW_CHANNEL_SUMS = 1,
+	};
+
+	static int get_view_key(ColorMode const mode, int const level, ViewKind const kind = VIEW_PIXELS)
+	{
+		return static_cast<int>(mode) | (level << 8) | (kind << 16);
+	}
+
+	// must be called with the cache locked
+	CHISL_MATRIX get_view_locked(ColorMode const mode, int const level) const
+	{
+		if (level <= 0 && (mode == ColorMode::Color || m_image.channels() == 1))
+		{
+			return m_image;
+		}
+
+		// the view of an area is the same area of the whole image's view
+		if (level <= 0 && m_parent)
+		{
+			return m_parent->get_view(mode)(m_area);
+		}
+
+		int key = get_view_key(mode, level);
+		auto found = m_cache->views.find(key);
+		if (found != m_cache->views.end())
+		{
+			return found->second;
+		}
+
+		CHISL_MATRIX view;
+		if (level > 0)
+		{
+			// shrink from full size, the same as shrinking each level in turn but without adding up the blur
+			CHISL_NUMBER const scale = 1.0 / (1 << level);
+			cv::resize(get_view_locked(mode, 0), view, cv::Size(), scale, scale, cv::INTER_AREA);
+		}
+		else
+		{
+			switch (mode)
+			{
+			case ColorMode::Gray:
+				cv::cvtColor(m_image, view, m_image.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+				break;
+			case ColorMode::Blue:
+				cv::extractChannel(m_image, view, 0);
+				break;
+			case ColorMode::Green:
+				cv::extractChannel(m_image, view, 1);
+				break;
+			case ColorMode::Red:
+				cv::extractChannel(m_image, view, 2);
+				break;
+			default:
+				return m_image;
+			}
+		}
+
+		m_cache->views.emplace(key, view);
+		return view;
+	}
+
+	Image(CHISL_MATRIX const image, std::shared_ptr<ImageCache> const cache)
+		: m_image(image), m_cache(cache)
+	{}
 
 public:
 	Image() = default;
@@ -449,70 +926,525 @@ public:
 	int get_width() const { return m_image.cols; }
 	int get_height() const { return m_image.rows; }
 	CHISL_POINT get_size() const { return CHISL_POINT{ get_width(), get_height() }; }
-	Image clone() const
+	// the size of the whole image, when this is an area of one
+	CHISL_POINT get_whole_size() const { return m_parent ? m_parent->get_whole_size() : get_size(); }
+	// the top left of this image within the whole image, when this is an area of one
+	CHISL_POINT get_offset() const { return m_parent ? m_parent->get_offset() + m_area.tl() : CHISL_POINT(0, 0); }
+
+	/// <summary>
+	/// Checks if this image shares any of its pixels with the other, such as a copy or a crop of it.
+	/// </summary>
+	/// <param name="other"></param>
+	/// <returns></returns>
+	bool shares(Image const& other) const { return m_image.datastart && m_image.datastart == other.m_image.datastart; }
+
+	/// <summary>
+	/// Gets an area of the image without copying it. Its views, sums and keypoints are taken from this image's,
+	/// so they are not worked out again for each area that is searched.
+	/// </summary>
+	/// <param name="area">The area, which must be within the image.</param>
+	/// <returns></returns>
+	Image region(cv::Rect const& area) const
 	{
-		CHISL_MATRIX mat;
-		m_image.copyTo(mat);
-		return Image(mat);
+		Image result(m_image(area));
+		result.m_parent = std::make_shared<Image const>(*this);
+		result.m_area = area;
+		return result;
 	}
-	CHISL_STRING to_string() const
+
+	/// <summary>
+	/// Gets the image with only the channels used by the color mode, halved the given number of times.
+	/// It is worked out the first time, then reused until the image is changed.
+	/// </summary>
+	/// <param name="mode"></param>
+	/// <param name="level"></param>
+	/// <returns></returns>
+	CHISL_MATRIX get_view(ColorMode const mode, int const level = 0) const
 	{
-		if (m_image.empty()) return "Image(empty)";
+		if (level <= 0 && (mode == ColorMode::Color || m_image.channels() == 1))
+		{
+			return m_image;
+		}
 
-		return std::format("Image({}, {})", get_width(), get_height());
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+		return get_view_locked(mode, level);
 	}
-};
 
-/// <summary>
-/// Holds data for a template match on another image.
-/// </summary>
-class Match
-{
-private:
-	CHISL_POINT m_size;
-	CHISL_POINT m_point;
+	/// <summary>
+	/// Works out the integral image of the squared values of the view, with the channels kept apart,
+	/// so the squared norm of any rectangle of it can be found in constant time.
+	/// It takes eight bytes per value, so it is worked out for each search that needs it instead of being kept on the image.
+	/// </summary>
+	/// <param name="mode"></param>
+	/// <returns></returns>
+	CHISL_MATRIX get_squared_integral(ColorMode const mode) const
+	{
+		// OpenCV always works out the plain sums alongside, which are dropped
+		CHISL_MATRIX view = get_view(mode);
+		CHISL_MATRIX sums, squaredSums;
+		cv::integral(view, sums, squaredSums, view.total() * 255 <= static_cast<size_t>(INT_MAX) ? CV_32S : CV_64F, CV_64F);
+		return squaredSums;
+	}
 
-public:
-	Match() = default;
-	Match(CHISL_POINT const size, CHISL_POINT const point)
-		: m_size(size), m_point(point) {}
+	/// <summary>
+	/// Gets the integral image of the view, with the channels kept apart,
+	/// so the sum of each channel of any rectangle of it can be found in constant time.
+	/// </summary>
+	/// <param name="mode"></param>
+	/// <returns></returns>
+	CHISL_MATRIX get_channel_integral(ColorMode const mode) const
+	{
+		if (m_parent)
+		{
+			return m_parent->get_channel_integral(mode)(cv::Rect(m_area.x, m_area.y, m_area.width + 1, m_area.height + 1));
+		}
 
-	CHISL_POINT get_size() const { return m_size; }
-	CHISL_POINT get_point() const { return m_point; }
-	CHISL_POINT get_center() const { return m_point + m_size / 2; }
-	bool empty() const { return !m_size.x && !m_size.y; }
-	CHISL_STRING to_string() const { return std::format("Match({}, {}, {}, {})", m_point.x, m_point.y, m_size.x, m_size.y); }
-};
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
 
-/// <summary>
-/// Holds data for a collection of Matches.
-/// </summary>
-class MatchCollection
-{
-private:
-	std::vector<Match> m_matches;
+		int key = get_view_key(mode, 0, VIEW_CHANNEL_SUMS);
+		auto found = m_cache->views.find(key);
+		if (found != m_cache->views.end())
+		{
+			return found->second;
+		}
 
-public:
-	MatchCollection() = default;
-	MatchCollection(CHISL_POINT const size, std::vector<CHISL_POINT> const& points)
-		: m_matches()
+		// 32 bit sums are faster to compare, and only overflow on images larger than a 4K screen
+		CHISL_MATRIX view = get_view_locked(mode, 0);
+		CHISL_MATRIX sums;
+		cv::integral(view, sums, view.total() * 255 <= static_cast<size_t>(INT_MAX) ? CV_32S : CV_64F);
+
+		m_cache->views.emplace(key, sums);
+		return sums;
+	}
+
+	/// <summary>
+	/// Gets the sum of every channel of every pixel of the view, and its norm.
+	/// </summary>
+	/// <param name="mode"></param>
+	/// <returns></returns>
+	std::pair<CHISL_NUMBER, CHISL_NUMBER> get_statistics(ColorMode const mode) const
 	{
-		m_matches.reserve(points.size());
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
 
-		for (auto const& point : points)
+		int key = get_view_key(mode, 0);
+		auto found = m_cache->statistics.find(key);
+		if (found != m_cache->statistics.end())
 		{
-			m_matches.push_back(Match(size, point));
+			return found->second;
 		}
-	}
-	MatchCollection(std::vector<Match> const& matches)
-		: m_matches(matches) { }
 
-	size_t count() const { return m_matches.size(); }
-	Match get(size_t const index) const { return m_matches.at(index); }
-	bool empty() const { return m_matches.empty(); }
-};
+		CHISL_MATRIX view = get_view_locked(mode, 0);
+		std::pair<CHISL_NUMBER, CHISL_NUMBER> statistics{ cv::sum(view.reshape(1))[0], cv::norm(view, cv::NORM_L2) };
 
-using Value = std::variant<nullptr_t, Image, Match, MatchCollection, CHISL_STRING, int, CHISL_NUMBER>;
+		m_cache->statistics.emplace(key, statistics);
+		return statistics;
+	}
+
+	/// <summary>
+	/// Gets the keypoints of the view, and their descriptors. Full color views use the grayscale ones.
+	/// They are found the first time, then reused until the image is changed.
+	/// </summary>
+	/// <param name="mode"></param>
+	/// <param name="count">The most keypoints to find, when they have not been found yet.</param>
+	/// <returns></returns>
+	std::shared_ptr<ImageFeatures const> get_features(ColorMode const mode, int const count) const
+	{
+		ColorMode const featureMode = mode == ColorMode::Color ? ColorMode::Gray : mode;
+
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+
+		int key = get_view_key(featureMode, 0);
+		auto found = m_cache->features.find(key);
+		if (found != m_cache->features.end())
+		{
+			return found->second;
+		}
+
+		std::shared_ptr<ImageFeatures> features = std::make_shared<ImageFeatures>();
+		if (m_parent)
+		{
+			// the keypoints of an area are the whole image's keypoints within it, so the whole image is only searched once
+			std::shared_ptr<ImageFeatures const> whole = m_parent->get_features(mode, count);
+			cv::Rect2f const area(m_area);
+			for (size_t i = 0; i < whole->keypoints.size(); i++)
+			{
+				cv::KeyPoint keypoint = whole->keypoints[i];
+				if (!area.contains(keypoint.pt))
+				{
+					continue;
+				}
+
+				keypoint.pt -= area.tl();
+				features->keypoints.push_back(keypoint);
+				features->descriptors.push_back(whole->descriptors.row(static_cast<int>(i)));
+			}
+		}
+		else
+		{
+			cv::Ptr<cv::ORB> orb = cv::ORB::create(count);
+			orb->detectAndCompute(get_view_locked(featureMode, 0), cv::noArray(), features->keypoints, features->descriptors);
+		}
+
+		m_cache->features.emplace(key, features);
+		return features;
+	}
+
+	/// <summary>
+	/// Gets the top left of where this image was last found within an image of the given size.
+	/// </summary>
+	/// <param name="size"></param>
+	/// <returns></returns>
+	std::optional<CHISL_POINT> get_last_match(CHISL_POINT const size) const
+	{
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+
+		auto found = m_cache->lastMatches.find(size.x | (size.y << 16));
+		if (found == m_cache->lastMatches.end())
+		{
+			return std::nullopt;
+		}
+		return found->second;
+	}
+
+	/// <summary>
+	/// Sets the top left of where this image was last found within an image of the given size.
+	/// </summary>
+	/// <param name="size"></param>
+	/// <param name="point"></param>
+	void set_last_match(CHISL_POINT const size, CHISL_POINT const point) const
+	{
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+		m_cache->lastMatches[size.x | (size.y << 16)] = point;
+	}
+
+	/// <summary>
+	/// Gets a copy of the image resized by the scale. Each copy is made the first time it is needed,
+	/// and keeps its own views and last match until this image is changed or the copy is dropped.
+	/// </summary>
+	/// <param name="scale"></param>
+	/// <returns></returns>
+	Image get_scaled(CHISL_NUMBER const scale) const
+	{
+		int key = static_cast<int>(std::lround(scale * 1000.0));
+		if (key == 1000)
+		{
+			return *this;
+		}
+
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+
+		auto found = m_cache->scaled.find(key);
+		if (found != m_cache->scaled.end())
+		{
+			return Image(found->second.first, found->second.second);
+		}
+
+		CHISL_MATRIX resized;
+		cv::Size size(std::max(static_cast<int>(std::lround(m_image.cols * scale)), 1), std::max(static_cast<int>(std::lround(m_image.rows * scale)), 1));
+		cv::resize(m_image, resized, size, 0.0, 0.0, scale < 1.0 ? cv::INTER_AREA : cv::INTER_LINEAR);
+
+		std::shared_ptr<ImageCache> cache = std::make_shared<ImageCache>();
+		m_cache->scaled.emplace(key, std::make_pair(resized, cache));
+		return Image(resized, cache);
+	}
+
+	/// <summary>
+	/// Gets the scale this image was last found at within an image of the given size.
+	/// </summary>
+	/// <param name="size"></param>
+	/// <returns></returns>
+	std::optional<CHISL_NUMBER> get_found_scale(CHISL_POINT const size) const
+	{
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+
+		auto found = m_cache->foundScales.find(size.x | (size.y << 16));
+		if (found == m_cache->foundScales.end())
+		{
+			return std::nullopt;
+		}
+		return found->second;
+	}
+
+	/// <summary>
+	/// Sets the scale this image was last found at within an image of the given size.
+	/// </summary>
+	/// <param name="size"></param>
+	/// <param name="scale"></param>
+	void set_found_scale(CHISL_POINT const size, CHISL_NUMBER const scale) const
+	{
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+		m_cache->foundScales[size.x | (size.y << 16)] = scale;
+	}
+
+	/// <summary>
+	/// Marks the pixels as being read by a command running in the background, until remove_reader is called.
+	/// </summary>
+	void add_reader() const
+	{
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+		m_cache->readers++;
+	}
+
+	void remove_reader() const
+	{
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+		m_cache->readers--;
+	}
+
+	/// <summary>
+	/// Marks the pixels as those of a loaded file. They stay marked even once the library lets go of the file,
+	/// since other variables may still hold the same load of it.
+	/// </summary>
+	void set_from_library() const
+	{
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+		m_cache->fromLibrary = true;
+	}
+
+	bool is_from_library() const
+	{
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+		return m_cache->fromLibrary;
+	}
+
+	/// <summary>
+	/// Checks if the pixels must not be changed in place, since they are those of a loaded file,
+	/// or a command running in the background is still reading them.
+	/// </summary>
+	/// <returns></returns>
+	bool is_shared() const
+	{
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+		return m_cache->fromLibrary || m_cache->readers > 0;
+	}
+
+	/// <summary>
+	/// Drops the resized copies of the image at every scale it has not been found at, on any display.
+	/// </summary>
+	void drop_unfound_scales() const
+	{
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+
+		for (auto it = m_cache->scaled.begin(); it != m_cache->scaled.end();)
+		{
+			bool found = std::any_of(m_cache->foundScales.begin(), m_cache->foundScales.end(),
+				[&](auto const& foundScale) { return std::lround(foundScale.second * 1000.0) == it->first; });
+
+			it = found ? std::next(it) : m_cache->scaled.erase(it);
+		}
+	}
+
+	/// <summary>
+	/// Clears the images worked out from this one. Must be called after changing the pixels.
+	/// </summary>
+	void invalidate()
+	{
+		std::lock_guard<std::mutex> lock(m_cache->mutex);
+		m_cache->views.clear();
+		m_cache->statistics.clear();
+		m_cache->scaled.clear();
+		m_cache->foundScales.clear();
+		m_cache->features.clear();
+	}
+
+	Image clone() const
+	{
+		CHISL_MATRIX mat;
+		m_image.copyTo(mat);
+		return Image(mat);
+	}
+	CHISL_STRING to_string() const
+	{
+		if (m_image.empty()) return "Image(empty)";
+
+		return std::format("Image({}, {})", get_width(), get_height());
+	}
+};
+
+/// <summary>
+/// Holds the images that have been loaded from files, by path, so loading a file again reuses
+/// its pixels and the images worked out from them until the file changes.
+/// Once the pixels held add up to more than IMAGE_LIBRARY_MAX_BYTES, the least recently loaded images are let go.
+/// </summary>
+class ImageLibrary
+{
+private:
+	struct Entry
+	{
+		std::filesystem::file_time_type time;
+		Image image;
+		// when the image was last loaded, counted in loads
+		uint64_t used;
+	};
+
+	std::mutex m_mutex;
+	std::unordered_map<CHISL_STRING, Entry> m_images;
+	uint64_t m_loads = 0;
+	size_t m_bytes = 0;
+
+	static size_t get_bytes(Image const& image)
+	{
+		return image.get().total() * image.get().elemSize();
+	}
+
+	// must be called with the library locked
+	void evict_locked()
+	{
+		while (m_bytes > IMAGE_LIBRARY_MAX_BYTES && m_images.size() > 1)
+		{
+			auto oldest = std::min_element(m_images.begin(), m_images.end(),
+				[](auto const& a, auto const& b) { return a.second.used < b.second.used; });
+
+			m_bytes -= get_bytes(oldest->second.image);
+			m_images.erase(oldest);
+		}
+	}
+
+public:
+	void set(CHISL_STRING const& path, std::filesystem::file_time_type const time, Image const& image)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto found = m_images.find(path);
+		if (found != m_images.end())
+		{
+			m_bytes -= get_bytes(found->second.image);
+		}
+
+		image.set_from_library();
+		m_images[path] = Entry{ time, image, ++m_loads };
+		m_bytes += get_bytes(image);
+
+		evict_locked();
+	}
+
+	std::optional<Image> get(CHISL_STRING const& path, std::filesystem::file_time_type const time)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto found = m_images.find(path);
+		if (found == m_images.end() || found->second.time != time)
+		{
+			return std::nullopt;
+		}
+
+		found->second.used = ++m_loads;
+		return found->second.image;
+	}
+
+	static ImageLibrary& get_instance()
+	{
+		static ImageLibrary library;
+		return library;
+	}
+};
+
+/// <summary>
+/// Holds data for a template match on another image.
+/// </summary>
+class Match
+{
+private:
+	CHISL_POINT m_size;
+	CHISL_POINT m_point;
+
+public:
+	Match() = default;
+	Match(CHISL_POINT const size, CHISL_POINT const point)
+		: m_size(size), m_point(point) {}
+
+	CHISL_POINT get_size() const { return m_size; }
+	CHISL_POINT get_point() const { return m_point; }
+	CHISL_POINT get_center() const { return m_point + m_size / 2; }
+	bool empty() const { return !m_size.x && !m_size.y; }
+	CHISL_STRING to_string() const { return std::format("Match({}, {}, {}, {})", m_point.x, m_point.y, m_size.x, m_size.y); }
+};
+
+/// <summary>
+/// Holds data for a collection of Matches.
+/// </summary>
+class MatchCollection
+{
+private:
+	std::vector<Match> m_matches;
+
+public:
+	MatchCollection() = default;
+	MatchCollection(CHISL_POINT const size, std::vector<CHISL_POINT> const& points)
+		: m_matches()
+	{
+		m_matches.reserve(points.size());
+
+		for (auto const& point : points)
+		{
+			m_matches.push_back(Match(size, point));
+		}
+	}
+	MatchCollection(std::vector<Match> const& matches)
+		: m_matches(matches) { }
+
+	size_t count() const { return m_matches.size(); }
+	Match get(size_t const index) const { return m_matches.at(index); }
+	bool empty() const { return m_matches.empty(); }
+};
+
+/// <summary>
+/// Holds data for a collection of text.
+/// </summary>
+class TextCollection
+{
+private:
+	std::vector<CHISL_STRING> m_texts;
+
+public:
+	TextCollection() = default;
+	TextCollection(std::vector<CHISL_STRING> const& texts)
+		: m_texts(texts) { }
+
+	size_t count() const { return m_texts.size(); }
+	CHISL_STRING get(size_t const index) const { return m_texts.at(index); }
+	bool empty() const { return m_texts.empty(); }
+};
+
+struct PendingState;
+
+/// <summary>
+/// Holds a value that is still being worked out on another thread.
+/// </summary>
+class Pending
+{
+private:
+	std::shared_ptr<PendingState> m_state;
+
+public:
+	Pending() = default;
+	Pending(std::shared_ptr<PendingState> const& state)
+		: m_state(state) { }
+
+	std::shared_ptr<PendingState> const& get_state() const { return m_state; }
+};
+
+using Value = std::variant<nullptr_t, Image, Match, MatchCollection, TextCollection, CHISL_STRING, int, CHISL_NUMBER, Pending>;
+
+struct PendingState
+{
+	std::shared_future<Value> future;
+};
+
+/// <summary>
+/// Waits for the pending value to be worked out.
+/// </summary>
+/// <param name="pending"></param>
+/// <returns></returns>
+Value resolve(Pending const& pending)
+{
+	if (!pending.get_state())
+	{
+		return nullptr;
+	}
+
+	return pending.get_state()->future.get();
+}
 
 CHISL_STRING value_to_string(Value const& value)
 {
@@ -539,6 +1471,17 @@ CHISL_STRING value_to_string(Value const& value)
 		}
 		return output;
 	}
+	else if (std::holds_alternative<TextCollection>(value))
+	{
+		TextCollection collection = std::get<TextCollection>(value);
+		size_t count = collection.count();
+		CHISL_STRING output = "TextCollection:";
+		for (size_t i = 0; i < count; i++)
+		{
+			output += std::format("\"{}\"", collection.get(i));
+		}
+		return output;
+	}
 	else if (std::holds_alternative<int>(value))
 	{
 		return std::to_string(std::get<int>(value));
@@ -547,6 +1490,10 @@ CHISL_STRING value_to_string(Value const& value)
 	{
 		return std::to_string(std::get<CHISL_NUMBER>(value));
 	}
+	else if (std::holds_alternative<Pending>(value))
+	{
+		return value_to_string(resolve(std::get<Pending>(value)));
+	}
 	else
 	{
 		return "";
@@ -576,6 +1523,10 @@ CHISL_NUMBER value_to_number(Value const& value)
 	{
 		return static_cast<CHISL_NUMBER>(!std::get<MatchCollection>(value).empty());
 	}
+	else if (std::holds_alternative<TextCollection>(value))
+	{
+		return static_cast<CHISL_NUMBER>(!std::get<TextCollection>(value).empty());
+	}
 	else if (std::holds_alternative<int>(value))
 	{
 		return static_cast<CHISL_NUMBER>(std::get<int>(value));
@@ -584,6 +1535,10 @@ CHISL_NUMBER value_to_number(Value const& value)
 	{
 		return std::get<CHISL_NUMBER>(value);
 	}
+	else if (std::holds_alternative<Pending>(value))
+	{
+		return value_to_number(resolve(std::get<Pending>(value)));
+	}
 
 	// unable to convert type
 	return 0.0;
@@ -597,8 +1552,9 @@ class Scope
 private:
 	/// <summary>
 	/// Holds values that can be updated or used by the script.
+	/// Pending values are replaced by their result the first time they are used.
 	/// </summary>
-	std::unordered_map<CHISL_STRING, Value> m_variables;
+	mutable std::unordered_map<CHISL_STRING, Value> m_variables;
 
 public:
 	Scope() = default;
@@ -640,15 +1596,37 @@ public:
 			return nullptr;
 		}
 
+		// wait for the value, then keep it so it is only waited on once
+		if (std::holds_alternative<Pending>(found->second))
+		{
+			found->second = resolve(std::get<Pending>(found->second));
+		}
+
 		return found->second;
 	}
 
-	void unset(CHISL_STRING const& name)
+	/// <summary>
+	/// Gets the image held by the variable, without waiting for it if it is still pending.
+	/// </summary>
+	/// <param name="name"></param>
+	/// <returns>The image, or nothing if the variable does not hold one yet.</returns>
+	std::optional<Image> peek_image(CHISL_STRING const& name) const
 	{
-		if (CONSTANTS_NAMES.contains(name))
+		auto found = m_variables.find(name);
+		if (found == m_variables.end() || !std::holds_alternative<Image>(found->second))
 		{
-			// cannot unset constant
-			return;
+			return std::nullopt;
+		}
+
+		return std::get<Image>(found->second);
+	}
+
+	void unset(CHISL_STRING const& name)
+	{
+		if (CONSTANTS_NAMES.contains(name))
+		{
+			// cannot unset constant
+			return;
 		}
 
 		m_variables.erase(name);
@@ -700,6 +1678,8 @@ enum ChislToken
 	//	Images
 	CHISL_KEYWORD_CAPTURE = 21000, // capture <var>
 	CHISL_KEYWORD_CAPTURE_AT = 21001, // capture <var> at <x> <y> <w> <h>
+	CHISL_KEYWORD_GET_COLOR = 21002, // get color <var> at <x> <y>
+	CHISL_KEYWORD_GET_COLOR_CHANNELS = 21003, // get color <r> <g> <b> at <x> <y>
 	CHISL_KEYWORD_CROP = 21010, // crop <var> to <x> <y> <w> <h>
 	CHISL_KEYWORD_FIND = 21020, // find <var> by <template> in <image>
 	CHISL_KEYWORD_FIND_WITH = 21021, // find <var> by <template> in <image> with <threshold>
@@ -709,10 +1689,28 @@ enum ChislToken
 	CHISL_KEYWORD_FIND_TEXT_WITH = 21025, // find text <block/paragraph/symbol/line/word> <var> by <text> in <image> with <threshold>
 	CHISL_KEYWORD_FIND_ALL_TEXT = 21026, // find all text <block/paragraph/symbol/line/word> <var> by <text> in <image>
 	CHISL_KEYWORD_FIND_ALL_TEXT_WITH = 21027, // find all text <block/paragraph/symbol/line/word> <var> by <text> in <image> with <threshold>
+	CHISL_KEYWORD_FIND_ANY = 21028, // find any <var> by <template>, <template>, ... in <image>
+	CHISL_KEYWORD_FIND_ANY_WITH = 21029, // find any <var> by <template>, <template>, ... in <image> with <threshold>
+	CHISL_KEYWORD_FIND_EACH = 21033, // find each <var> by <template>, <template>, ... in <image>
+	CHISL_KEYWORD_FIND_EACH_WITH = 21034, // find each <var> by <template>, <template>, ... in <image> with <threshold>
 	CHISL_KEYWORD_READ = 21030, // read <var> from <image>
+	CHISL_KEYWORD_READ_ALL = 21031, // read all <var> from <image> at <matches>
+	CHISL_KEYWORD_LEARN = 21032, // learn <name> from <image> with <characters>
 	CHISL_KEYWORD_DRAW = 21040, // draw <match> on <image>
 	CHISL_KEYWORD_DRAW_RECT = 21041, // draw <x> <y> <w> <h> on <image>
 	CHISL_KEYWORD_TARGET = 21050, // target monitor <number>
+	CHISL_KEYWORD_FIND_AT = 21060, // find <var> by <template> in <image> at <x> <y> <w> <h>
+	CHISL_KEYWORD_FIND_AT_WITH = 21061, // find <var> by <template> in <image> at <x> <y> <w> <h> with <threshold>
+	CHISL_KEYWORD_FIND_ALL_AT = 21062, // find all <var> by <template> in <image> at <x> <y> <w> <h>
+	CHISL_KEYWORD_FIND_ALL_AT_WITH = 21063, // find all <var> by <template> in <image> at <x> <y> <w> <h> with <threshold>
+	CHISL_KEYWORD_FIND_WITHIN = 21064, // find <var> by <template> in <image> within <match>
+	CHISL_KEYWORD_FIND_WITHIN_WITH = 21065, // find <var> by <template> in <image> within <match> with <threshold>
+	CHISL_KEYWORD_FIND_ALL_WITHIN = 21066, // find all <var> by <template> in <image> within <match>
+	CHISL_KEYWORD_FIND_ALL_WITHIN_WITH = 21067, // find all <var> by <template> in <image> within <match> with <threshold>
+	CHISL_KEYWORD_FIND_COLOR = 21068, // find color <var> by <r> <g> <b> [tolerance <t>] in <image>
+	CHISL_KEYWORD_FIND_COLOR_AT = 21069, // find color <var> by <r> <g> <b> [tolerance <t>] in <image> at <x> <y> <w> <h>
+	CHISL_KEYWORD_FIND_ALL_COLOR = 21070, // find all color <var> by <r> <g> <b> [tolerance <t>] in <image>
+	CHISL_KEYWORD_FIND_ALL_COLOR_AT = 21071, // find all color <var> by <r> <g> <b> [tolerance <t>] in <image> at <x> <y> <w> <h>
 
 	//	Util
 	CHISL_KEYWORD_WAIT = 22000, // wait <time> <ms/s/m/h>
@@ -754,6 +1752,8 @@ enum ChislToken
 	// Scripting
 	CHISL_KEYWORD_RECORD = 26000, // record to <path>
 	CHISL_KEYWORD_RUN = 26010, // run <program>
+	CHISL_KEYWORD_ASYNC = 26020, // async <command>
+	CHISL_KEYWORD_AWAIT = 26030, // await <var>
 
 	// Configuration
 	CHISL_KEYWORD_CONFIGURE = 27000, // configure <setting> to <value>
@@ -883,6 +1883,8 @@ CHISL_STRING string_token_type(ChislToken const token)
 
 		{ CHISL_KEYWORD_CAPTURE, "capture" },
 		{ CHISL_KEYWORD_CAPTURE_AT, "capture at" },
+		{ CHISL_KEYWORD_GET_COLOR, "get color" },
+		{ CHISL_KEYWORD_GET_COLOR_CHANNELS, "get color channels" },
 		{ CHISL_KEYWORD_CROP, "crop" },
 		{ CHISL_KEYWORD_FIND, "find" },
 		{ CHISL_KEYWORD_FIND_WITH, "find with" },
@@ -892,10 +1894,28 @@ CHISL_STRING string_token_type(ChislToken const token)
 		{ CHISL_KEYWORD_FIND_TEXT_WITH, "find text with" },
 		{ CHISL_KEYWORD_FIND_ALL_TEXT, "find all text" },
 		{ CHISL_KEYWORD_FIND_ALL_TEXT_WITH, "find all text with" },
+		{ CHISL_KEYWORD_FIND_ANY, "find any" },
+		{ CHISL_KEYWORD_FIND_ANY_WITH, "find any with" },
+		{ CHISL_KEYWORD_FIND_EACH, "find each" },
+		{ CHISL_KEYWORD_FIND_EACH_WITH, "find each with" },
 		{ CHISL_KEYWORD_READ, "read" },
+		{ CHISL_KEYWORD_READ_ALL, "read all" },
+		{ CHISL_KEYWORD_LEARN, "learn" },
 		{ CHISL_KEYWORD_DRAW, "draw" },
 		{ CHISL_KEYWORD_DRAW_RECT, "draw rect" },
 		{ CHISL_KEYWORD_TARGET, "target monitor" },
+		{ CHISL_KEYWORD_FIND_AT, "find at" },
+		{ CHISL_KEYWORD_FIND_AT_WITH, "find at with" },
+		{ CHISL_KEYWORD_FIND_ALL_AT, "find all at" },
+		{ CHISL_KEYWORD_FIND_ALL_AT_WITH, "find all at with" },
+		{ CHISL_KEYWORD_FIND_WITHIN, "find within" },
+		{ CHISL_KEYWORD_FIND_WITHIN_WITH, "find within with" },
+		{ CHISL_KEYWORD_FIND_ALL_WITHIN, "find all within" },
+		{ CHISL_KEYWORD_FIND_ALL_WITHIN_WITH, "find all within with" },
+		{ CHISL_KEYWORD_FIND_COLOR, "find color" },
+		{ CHISL_KEYWORD_FIND_COLOR_AT, "find color at" },
+		{ CHISL_KEYWORD_FIND_ALL_COLOR, "find all color" },
+		{ CHISL_KEYWORD_FIND_ALL_COLOR_AT, "find all color at" },
 
 		{ CHISL_KEYWORD_WAIT, "wait" },
 		{ CHISL_KEYWORD_COUNTDOWN, "countdown" },
@@ -932,6 +1952,8 @@ CHISL_STRING string_token_type(ChislToken const token)
 
 		{ CHISL_KEYWORD_RECORD, "record" },
 		{ CHISL_KEYWORD_RUN, "run" },
+		{ CHISL_KEYWORD_ASYNC, "async" },
+		{ CHISL_KEYWORD_AWAIT, "await" },
 
 		{ CHISL_KEYWORD_CONFIGURE, "configure" },
 
@@ -1010,7 +2032,28 @@ CHISL_STRING tokens_to_string(std::vector<Token> const& tokens, CHISL_STRING con
 	return result;
 }
 
-CHISL_MATRIX hwnd2mat(HWND hwnd)
+/// <summary>
+/// Gets the area of the window that can be captured.
+/// </summary>
+/// <param name="hwnd"></param>
+/// <returns></returns>
+cv::Rect get_client_rect(HWND hwnd)
+{
+	SetProcessDPIAware();
+
+	RECT windowsize;
+	GetClientRect(hwnd, &windowsize);
+
+	return cv::Rect(0, 0, windowsize.right, windowsize.bottom);
+}
+
+/// <summary>
+/// Copies the pixels within the area of the window, and only those, into a BGRA matrix.
+/// </summary>
+/// <param name="hwnd"></param>
+/// <param name="region">The area to copy, which must be within the window.</param>
+/// <returns></returns>
+CHISL_MATRIX hwnd2mat(HWND hwnd, cv::Rect const& region)
 {
 	HDC hwindowDC, hwindowCompatibleDC;
 
@@ -1025,13 +2068,10 @@ CHISL_MATRIX hwnd2mat(HWND hwnd)
 	hwindowCompatibleDC = CreateCompatibleDC(hwindowDC);
 	SetStretchBltMode(hwindowCompatibleDC, COLORONCOLOR);
 
-	RECT windowsize;    // get the height and width of the screen
-	GetClientRect(hwnd, &windowsize);
-
-	srcheight = windowsize.bottom;
-	srcwidth = windowsize.right;
-	height = windowsize.bottom;
-	width = windowsize.right;
+	srcheight = region.height;
+	srcwidth = region.width;
+	height = region.height;
+	width = region.width;
 
 	src.create(height, width, CV_8UC4);
 
@@ -1052,7 +2092,7 @@ CHISL_MATRIX hwnd2mat(HWND hwnd)
 	// use the previously created device context with the bitmap
 	SelectObject(hwindowCompatibleDC, hbwindow);
 	// copy from the window device context to the bitmap device context
-	StretchBlt(hwindowCompatibleDC, 0, 0, width, height, hwindowDC, 0, 0, srcwidth, srcheight, SRCCOPY); //change SRCCOPY to NOTSRCCOPY for wacky colors !
+	StretchBlt(hwindowCompatibleDC, 0, 0, width, height, hwindowDC, region.x, region.y, srcwidth, srcheight, SRCCOPY); //change SRCCOPY to NOTSRCCOPY for wacky colors !
 	GetDIBits(hwindowCompatibleDC, hbwindow, 0, height, src.data, (BITMAPINFO*)&bi, DIB_RGB_COLORS);  //copy from hwindowCompatibleDC to hbwindow
 
 	// avoid memory leak
@@ -1063,6 +2103,11 @@ CHISL_MATRIX hwnd2mat(HWND hwnd)
 	return src;
 }
 
+CHISL_MATRIX hwnd2mat(HWND hwnd)
+{
+	return hwnd2mat(hwnd, get_client_rect(hwnd));
+}
+
 /// <summary>
 /// Reads text from a file.
 /// </summary>
@@ -1103,12 +2148,25 @@ std::optional<Image> image_read(CHISL_STRING const& path)
 	}
 
 	try {
+		// reuse the image from the last time the file was loaded, if it has not changed since
+		CHISL_STRING key = std::filesystem::absolute(path).lexically_normal().string();
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(path);
+
+		std::optional<Image> loaded = ImageLibrary::get_instance().get(key, time);
+		if (loaded.has_value())
+		{
+			return loaded;
+		}
+
 		CHISL_MATRIX image = cv::imread(path, cv::IMREAD_COLOR);
 		if (image.empty()) {
 			std::cerr << "Failed to read image. " << path << " is empty." << std::endl;
 			return std::nullopt;
 		}
-		return Image(image);
+
+		Image loadedImage(image);
+		ImageLibrary::get_instance().set(key, time, loadedImage);
+		return loadedImage;
 	}
 	catch (const cv::Exception& ex) {
 		std::cerr << "OpenCV exception: " << ex.what() << std::endl;
@@ -1289,6 +2347,45 @@ Image screenshot()
 	return Image(screenConverted);
 }
 
+/// <summary>
+/// Takes a screenshot of part of the screen. Only that part is copied and converted,
+/// so small areas take a fraction of the time of a whole screenshot.
+/// </summary>
+/// <param name="region"></param>
+/// <returns>The part of the region on the screen, or an empty image if none of it is.</returns>
+Image screenshot(cv::Rect const& region)
+{
+	HWND hwnd = GetDesktopWindow();
+
+	cv::Rect area = region & get_client_rect(hwnd);
+	if (area.empty())
+	{
+		return Image();
+	}
+
+	CHISL_MATRIX screen = hwnd2mat(hwnd, area);
+	CHISL_MATRIX screenConverted;
+	cv::cvtColor(screen, screenConverted, cv::COLOR_BGRA2BGR);
+	return Image(screenConverted);
+}
+
+/// <summary>
+/// Gets the color of one pixel on the screen, copying only that pixel.
+/// </summary>
+/// <param name="x"></param>
+/// <param name="y"></param>
+/// <returns>The blue, green and red of the pixel, or nothing if it is not on the screen.</returns>
+std::optional<cv::Vec3b> get_screen_pixel(int const x, int const y)
+{
+	Image image = screenshot(cv::Rect(x, y, 1, 1));
+	if (image.empty())
+	{
+		return std::nullopt;
+	}
+
+	return image.get().at<cv::Vec3b>(0, 0);
+}
+
 /// <summary>
 /// Crops the given image.
 /// </summary>
@@ -1301,7 +2398,15 @@ Image screenshot()
 Image crop(Image& image, int const x, int const y, int const w, int const h)
 {
 	cv::Rect rect(x, y, w, h);
-	return Image(image.get()(rect));
+	Image cropped(image.get()(rect));
+
+	// a crop of a loaded image still shares the file's pixels
+	if (image.is_from_library())
+	{
+		cropped.set_from_library();
+	}
+
+	return cropped;
 }
 
 /// <summary>
@@ -1330,44 +2435,2563 @@ CHISL_MATRIX resize(const CHISL_MATRIX& image, CHISL_NUMBER const scale)
 }
 
 /// <summary>
-/// Adjusts an image for reading text.
+/// Holds buffers that are reused each time an image is prepared for reading.
 /// </summary>
-/// <param name="image"></param>
+struct ReadBuffer
+{
+	CHISL_MATRIX gray;
+	CHISL_MATRIX output;
+	std::vector<uchar> luma;
+	std::vector<ushort> rows[2];
+	std::vector<int> xOffsets;
+	std::vector<ushort> xWeights;
+};
+
+/// <summary>
+/// Converts a row of BGR, BGRA or grayscale pixels into luminance.
+/// </summary>
+/// <param name="src"></param>
+/// <param name="dst"></param>
+/// <param name="width"></param>
+/// <param name="channels"></param>
+void convert_row_to_luma(uchar const* src, uchar* dst, int const width, int const channels)
+{
+	if (channels == 1)
+	{
+		std::memcpy(dst, src, width);
+		return;
+	}
+
+	int x = 0;
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+	int const lanes = cv::VTraits<cv::v_uint8>::vlanes();
+	cv::v_uint16 const weightB = cv::vx_setall_u16(LUMA_WEIGHT_B);
+	cv::v_uint16 const weightG = cv::vx_setall_u16(LUMA_WEIGHT_G);
+	cv::v_uint16 const weightR = cv::vx_setall_u16(LUMA_WEIGHT_R);
+	cv::v_uint16 const half = cv::vx_setall_u16(128);
+
+	for (; x <= width - lanes; x += lanes)
+	{
+		cv::v_uint8 b, g, r, a;
+
+		if (channels == 3)
+		{
+			cv::v_load_deinterleave(src + x * 3, b, g, r);
+		}
+		else
+		{
+			cv::v_load_deinterleave(src + x * 4, b, g, r, a);
+		}
+
+		cv::v_uint16 b0, b1, g0, g1, r0, r1;
+		cv::v_expand(b, b0, b1);
+		cv::v_expand(g, g0, g1);
+		cv::v_expand(r, r0, r1);
+
+		// weights add up to 256, so the sums fit within 16 bits
+		cv::v_uint16 y0 = cv::v_add(cv::v_add(cv::v_mul_wrap(b0, weightB), cv::v_mul_wrap(g0, weightG)), cv::v_add(cv::v_mul_wrap(r0, weightR), half));
+		cv::v_uint16 y1 = cv::v_add(cv::v_add(cv::v_mul_wrap(b1, weightB), cv::v_mul_wrap(g1, weightG)), cv::v_add(cv::v_mul_wrap(r1, weightR), half));
+
+		cv::v_store(dst + x, cv::v_pack(cv::v_shr<8>(y0), cv::v_shr<8>(y1)));
+	}
+#endif
+
+	for (; x < width; x++)
+	{
+		uchar const* pixel = src + x * channels;
+		dst[x] = static_cast<uchar>((pixel[0] * LUMA_WEIGHT_B + pixel[1] * LUMA_WEIGHT_G + pixel[2] * LUMA_WEIGHT_R + 128) >> 8);
+	}
+}
+
+/// <summary>
+/// Linearly resizes a row of luminance horizontally. The results are in 8.8 fixed point.
+/// </summary>
+/// <param name="src"></param>
+/// <param name="dst"></param>
+/// <param name="width">The width of the destination.</param>
+/// <param name="srcWidth"></param>
+/// <param name="xOffsets"></param>
+/// <param name="xWeights"></param>
+void resize_row(uchar const* src, ushort* dst, int const width, int const srcWidth, int const* xOffsets, ushort const* xWeights)
+{
+	int const last = srcWidth - 1;
+
+	for (int x = 0; x < width; x++)
+	{
+		int const left = xOffsets[x];
+		int const right = std::min(left + 1, last);
+		int const weight = xWeights[x];
+
+		dst[x] = static_cast<ushort>(src[left] * (256 - weight) + src[right] * weight);
+	}
+}
+
+/// <summary>
+/// Blends two horizontally resized rows into a single row of luminance, and thresholds it if needed.
+/// </summary>
+/// <param name="top"></param>
+/// <param name="bottom"></param>
+/// <param name="dst"></param>
+/// <param name="width"></param>
+/// <param name="weight">The weight of the bottom row, out of 256.</param>
+/// <param name="threshold">The luminance above which pixels become white, or -1 to not threshold.</param>
+/// <param name="invert">If true, the thresholded pixels are flipped.</param>
+void blend_rows(ushort const* top, ushort const* bottom, uchar* dst, int const width, int const weight, int const threshold, bool const invert)
+{
+	int x = 0;
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+	int const lanes8 = cv::VTraits<cv::v_uint8>::vlanes();
+	int const lanes16 = cv::VTraits<cv::v_uint16>::vlanes();
+	cv::v_uint16 const weightTop = cv::vx_setall_u16(static_cast<ushort>(256 - weight));
+	cv::v_uint16 const weightBottom = cv::vx_setall_u16(static_cast<ushort>(weight));
+	cv::v_uint32 const half = cv::vx_setall_u32(1 << 15);
+	cv::v_uint8 const thresholdValue = cv::vx_setall_u8(static_cast<uchar>(std::clamp(threshold, 0, 255)));
+
+	auto blend = [&](cv::v_uint16 const& t, cv::v_uint16 const& b) {
+		cv::v_uint32 t0, t1, b0, b1;
+		cv::v_mul_expand(t, weightTop, t0, t1);
+		cv::v_mul_expand(b, weightBottom, b0, b1);
+		return cv::v_pack(cv::v_shr<16>(cv::v_add(cv::v_add(t0, b0), half)), cv::v_shr<16>(cv::v_add(cv::v_add(t1, b1), half)));
+		};
+
+	for (; x <= width - lanes8; x += lanes8)
+	{
+		cv::v_uint16 y0 = blend(cv::vx_load(top + x), cv::vx_load(bottom + x));
+		cv::v_uint16 y1 = blend(cv::vx_load(top + x + lanes16), cv::vx_load(bottom + x + lanes16));
+		cv::v_uint8 y = cv::v_pack(y0, y1);
+
+		if (threshold >= 0)
+		{
+			// comparisons give all bits set when true, which is white
+			y = cv::v_gt(y, thresholdValue);
+
+			if (invert)
+			{
+				y = cv::v_not(y);
+			}
+		}
+
+		cv::v_store(dst + x, y);
+	}
+#endif
+
+	for (; x < width; x++)
+	{
+		int y = (top[x] * (256 - weight) + bottom[x] * weight + (1 << 15)) >> 16;
+
+		if (threshold >= 0)
+		{
+			y = ((y > threshold) != invert) ? 255 : 0;
+		}
+
+		dst[x] = static_cast<uchar>(y);
+	}
+}
+
+/// <summary>
+/// Converts the matrix to luminance, linearly resizes it and optionally thresholds it, all in a single pass.
+/// </summary>
+/// <param name="src">A BGR, BGRA or grayscale matrix.</param>
+/// <param name="scale"></param>
+/// <param name="threshold">The luminance above which pixels become white, or -1 to not threshold.</param>
+/// <param name="invert">If true, the thresholded pixels are flipped.</param>
+/// <param name="dst">The output. Its memory is reused if it is already the right size.</param>
+/// <param name="buffer"></param>
+void preprocess_for_reading(const CHISL_MATRIX& src, CHISL_NUMBER const scale, int const threshold, bool const invert, CHISL_MATRIX& dst, ReadBuffer& buffer)
+{
+	int const channels = src.channels();
+	int const srcWidth = src.cols;
+	int const srcHeight = src.rows;
+	int const width = std::max(static_cast<int>(std::round(srcWidth * scale)), 1);
+	int const height = std::max(static_cast<int>(std::round(srcHeight * scale)), 1);
+
+	dst.create(height, width, CV_8UC1);
+
+	// map each destination column to its source columns
+	buffer.luma.resize(srcWidth);
+	buffer.rows[0].resize(width);
+	buffer.rows[1].resize(width);
+	buffer.xOffsets.resize(width);
+	buffer.xWeights.resize(width);
+
+	CHISL_NUMBER const inverseScale = 1.0 / scale;
+
+	for (int x = 0; x < width; x++)
+	{
+		CHISL_NUMBER sx = std::max((x + 0.5) * inverseScale - 0.5, 0.0);
+		int left = std::min(static_cast<int>(sx), srcWidth - 1);
+		buffer.xOffsets[x] = left;
+		buffer.xWeights[x] = static_cast<ushort>(std::clamp(std::round((sx - left) * 256.0), 0.0, 256.0));
+	}
+
+	// each source row is converted and resized once, even when it is used by multiple destination rows
+	int cached[2] = { -1, -1 };
+
+	auto fetch = [&](int const sy, int const other) -> ushort const* {
+		for (int i = 0; i < 2; i++)
+		{
+			if (cached[i] == sy)
+			{
+				return buffer.rows[i].data();
+			}
+		}
+
+		// do not overwrite the other row that is needed
+		int slot = cached[0] == other ? 1 : 0;
+
+		convert_row_to_luma(src.ptr<uchar>(sy), buffer.luma.data(), srcWidth, channels);
+		resize_row(buffer.luma.data(), buffer.rows[slot].data(), width, srcWidth, buffer.xOffsets.data(), buffer.xWeights.data());
+		cached[slot] = sy;
+
+		return buffer.rows[slot].data();
+		};
+
+	for (int y = 0; y < height; y++)
+	{
+		CHISL_NUMBER sy = std::max((y + 0.5) * inverseScale - 0.5, 0.0);
+		int topRow = std::min(static_cast<int>(sy), srcHeight - 1);
+		int bottomRow = std::min(topRow + 1, srcHeight - 1);
+		int weight = static_cast<int>(std::clamp(std::round((sy - topRow) * 256.0), 0.0, 256.0));
+
+		ushort const* top = fetch(topRow, bottomRow);
+		ushort const* bottom = fetch(bottomRow, topRow);
+
+		blend_rows(top, bottom, dst.ptr<uchar>(y), width, weight, threshold, invert);
+	}
+}
+
+/// <summary>
+/// Finds the threshold that best separates the text from the background of the grayscale matrix, using Otsu's method.
+/// </summary>
+/// <param name="gray"></param>
+/// <param name="invert">Set to true when most of the matrix is below the threshold, meaning the text is light on a dark background.</param>
 /// <returns></returns>
-Image adjust_image_for_reading(Image const& image)
+int otsu_threshold(const CHISL_MATRIX& gray, bool& invert)
 {
-	CHISL_MATRIX mat = image.get();
+	std::array<size_t, 256> histogram{};
+
+	for (int y = 0; y < gray.rows; y++)
+	{
+		uchar const* row = gray.ptr<uchar>(y);
+
+		for (int x = 0; x < gray.cols; x++)
+		{
+			histogram[row[x]]++;
+		}
+	}
+
+	size_t const total = gray.total();
+	CHISL_NUMBER sum = 0.0;
+
+	for (int i = 0; i < 256; i++)
+	{
+		sum += static_cast<CHISL_NUMBER>(i) * histogram[i];
+	}
 
-	mat = grayscale(mat);
+	CHISL_NUMBER sumBackground = 0.0;
+	size_t weightBackground = 0;
+	CHISL_NUMBER bestVariance = -1.0;
+	int threshold = 0;
 
-	mat = resize(mat, 4.0);
+	for (int i = 0; i < 256; i++)
+	{
+		weightBackground += histogram[i];
 
-	return Image(mat);
+		if (weightBackground == 0)
+		{
+			continue;
+		}
+
+		size_t weightForeground = total - weightBackground;
+
+		if (weightForeground == 0)
+		{
+			break;
+		}
+
+		sumBackground += static_cast<CHISL_NUMBER>(i) * histogram[i];
+
+		CHISL_NUMBER meanBackground = sumBackground / weightBackground;
+		CHISL_NUMBER meanForeground = (sum - sumBackground) / weightForeground;
+		CHISL_NUMBER difference = meanBackground - meanForeground;
+		CHISL_NUMBER variance = static_cast<CHISL_NUMBER>(weightBackground) * weightForeground * difference * difference;
+
+		if (variance > bestVariance)
+		{
+			bestVariance = variance;
+			threshold = i;
+		}
+	}
+
+	size_t above = 0;
+
+	for (int i = threshold + 1; i < 256; i++)
+	{
+		above += histogram[i];
+	}
+
+	invert = above < total / 2;
+
+	return threshold;
+}
+
+/// <summary>
+/// Converts the grayscale matrix to black and white, with the text being black.
+/// </summary>
+/// <param name="gray"></param>
+/// <param name="threshold">The luminance above which pixels become white, from otsu_threshold.</param>
+/// <param name="invert">If true, the thresholded pixels are flipped.</param>
+/// <returns></returns>
+CHISL_MATRIX binarize(const CHISL_MATRIX& gray, int const threshold, bool const invert)
+{
+	CHISL_MATRIX binary;
+	cv::threshold(gray, binary, threshold, 255, invert ? cv::THRESH_BINARY_INV : cv::THRESH_BINARY);
+
+	return binary;
+}
+
+/// <summary>
+/// Estimates the height of the text within the grayscale matrix, using the median height of its connected components.
+/// </summary>
+/// <param name="gray"></param>
+/// <returns>The height in pixels, or 0 if no text-like components were found.</returns>
+CHISL_NUMBER estimate_text_height(const CHISL_MATRIX& gray)
+{
+	// glyphs become the white foreground
+	bool invert;
+	int threshold = otsu_threshold(gray, invert);
+
+	CHISL_MATRIX foreground;
+	cv::threshold(gray, foreground, threshold, 255, invert ? cv::THRESH_BINARY : cv::THRESH_BINARY_INV);
+
+	CHISL_MATRIX labels, stats, centroids;
+	int count = cv::connectedComponentsWithStats(foreground, labels, stats, centroids, 8, CV_32S);
+
+	std::vector<int> heights;
+	heights.reserve(count);
+
+	// skip label 0, the background
+	for (int i = 1; i < count; i++)
+	{
+		int w = stats.at<int>(i, cv::CC_STAT_WIDTH);
+		int h = stats.at<int>(i, cv::CC_STAT_HEIGHT);
+		int area = stats.at<int>(i, cv::CC_STAT_AREA);
+
+		// ignore specks, separators and large blobs, which are unlikely to be glyphs
+		if (h < 3 || h > gray.rows / 2 || w > h * 4 || area < 4)
+		{
+			continue;
+		}
+
+		heights.push_back(h);
+	}
+
+	if (heights.empty())
+	{
+		return 0.0;
+	}
+
+	auto middle = heights.begin() + heights.size() / 2;
+	std::nth_element(heights.begin(), middle, heights.end());
+	return static_cast<CHISL_NUMBER>(*middle);
+}
+
+/// <summary>
+/// Gets the scale to resize the grayscale matrix by so that its text is the target height.
+/// </summary>
+/// <param name="gray"></param>
+/// <param name="options"></param>
+/// <returns></returns>
+CHISL_NUMBER get_reading_scale(const CHISL_MATRIX& gray, ReadOptions const& options)
+{
+	if (options.scale > 0.0)
+	{
+		return options.scale;
+	}
+
+	CHISL_NUMBER textHeight = estimate_text_height(gray);
+
+	if (textHeight <= 0.0)
+	{
+		// nothing to go off of, so use the largest scale to be safe
+		return MAX_READING_SCALE;
+	}
+
+	return std::clamp(options.textHeight / textHeight, MIN_READING_SCALE, MAX_READING_SCALE);
+}
+
+/// <summary>
+/// Adjusts an image for reading text. Both ways of doing it pick the scale and threshold from the luminance at its original size,
+/// and threshold after resizing.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="options"></param>
+/// <returns>The adjusted image. When fused, its pixels are reused by the next call on the same thread, so it must be read before then.</returns>
+Image adjust_image_for_reading(Image const& image, ReadOptions const& options)
+{
+	CHISL_MATRIX const& src = image.get();
+	int const channels = src.channels();
+
+	if (options.fused && src.depth() == CV_8U && (channels == 1 || channels == 3 || channels == 4))
+	{
+		// reused between reads on the same thread, and not copied out, since each caller hands it to the engine straight away
+		thread_local ReadBuffer buffer;
+
+		if (options.scale > 0.0 && !options.binarize)
+		{
+			preprocess_for_reading(src, options.scale, -1, false, buffer.output, buffer);
+			return Image(buffer.output);
+		}
+
+		// the scale and threshold are picked from the luminance at its original size, which grayscale input already is
+		if (channels != 1)
+		{
+			preprocess_for_reading(src, 1.0, -1, false, buffer.gray, buffer);
+		}
+
+		CHISL_MATRIX const& gray = channels == 1 ? src : buffer.gray;
+
+		CHISL_NUMBER scale = get_reading_scale(gray, options);
+		int threshold = -1;
+		bool invert = false;
+
+		if (options.binarize)
+		{
+			threshold = otsu_threshold(gray, invert);
+		}
+		else if (scale == 1.0)
+		{
+			return Image(gray);
+		}
+
+		preprocess_for_reading(gray, scale, threshold, invert, buffer.output, buffer);
+		return Image(buffer.output);
+	}
+
+	CHISL_MATRIX mat = src.channels() == 1 ? src : grayscale(src);
+
+	CHISL_NUMBER scale = get_reading_scale(mat, options);
+
+	// the same order as the fused pass, so both read the same
+	int threshold = 0;
+	bool invert = false;
+
+	if (options.binarize)
+	{
+		threshold = otsu_threshold(mat, invert);
+	}
+
+	if (scale != 1.0)
+	{
+		mat = resize(mat, scale);
+	}
+
+	if (options.binarize)
+	{
+		mat = binarize(mat, threshold, invert);
+	}
+
+	return Image(mat);
+}
+
+/// <summary>
+/// Splits the scores of matching a template within an image into tiles, so they can be worked out at once.
+/// Each tile of scores needs the part of the image it covers, plus the size of the template, so tiles are kept
+/// large compared to the template to keep that overlap small.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="templ"></param>
+/// <returns>The area of the scores covered by each tile.</returns>
+std::vector<cv::Rect> get_match_tiles(const CHISL_MATRIX& image, const CHISL_MATRIX& templ)
+{
+	int const resultWidth = image.cols - templ.cols + 1;
+	int const resultHeight = image.rows - templ.rows + 1;
+
+	int const tileWidth = std::max(MATCH_TILE_SIZE, templ.cols * 4);
+	int const tileHeight = std::max(MATCH_TILE_SIZE, templ.rows * 4);
+
+	std::vector<cv::Rect> tiles;
+
+	for (int y = 0; y < resultHeight; y += tileHeight)
+	{
+		for (int x = 0; x < resultWidth; x += tileWidth)
+		{
+			tiles.push_back(cv::Rect(x, y, std::min(tileWidth, resultWidth - x), std::min(tileHeight, resultHeight - y)));
+		}
+	}
+
+	return tiles;
+}
+
+/// <summary>
+/// Gets the part of the image needed to work out the given tile of scores.
+/// </summary>
+/// <param name="tile"></param>
+/// <param name="templ"></param>
+/// <returns></returns>
+cv::Rect get_match_tile_source(cv::Rect const& tile, const CHISL_MATRIX& templ)
+{
+	return cv::Rect(tile.x, tile.y, tile.width + templ.cols - 1, tile.height + templ.rows - 1);
+}
+
+/// <summary>
+/// Counts how many tiles the prefilter was given, and how many of them it ruled out.
+/// </summary>
+struct PrefilterCounters
+{
+	std::atomic<CHISL_INT> tiles = 0;
+	std::atomic<CHISL_INT> skipped = 0;
+
+	static PrefilterCounters& get_instance()
+	{
+		static PrefilterCounters counters;
+		return counters;
+	}
+
+	/// <summary>
+	/// Gets the fraction of the tiles that were ruled out, from 0 to 1.
+	/// </summary>
+	/// <returns></returns>
+	CHISL_NUMBER get_skipped() const
+	{
+		CHISL_INT total = tiles.load();
+		return total > 0 ? static_cast<CHISL_NUMBER>(skipped.load()) / total : 0.0;
+	}
+};
+
+/// <summary>
+/// Works out which spots within the image could match the template, by comparing the mean of each channel of the spot
+/// against the template's. The sums of each spot come from the integral image, which is worked out once per image.
+/// This is a heuristic, not a bound: correlation does not change with the brightness of a spot, so a spot whose mean
+/// is further than the tolerance from the template's can still score above any threshold, and is then not found.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="templateImage"></param>
+/// <param name="mode"></param>
+/// <param name="tolerance">How far, from 0 to 255, the mean of each channel can be from the template's.</param>
+/// <returns>A mask the size of the scores, which is set for each spot that could match.</returns>
+CHISL_MATRIX get_prefilter_mask(Image const& image, Image const& templateImage, ColorMode const mode, CHISL_NUMBER const tolerance)
+{
+	CHISL_MATRIX src = image.get_view(mode);
+	CHISL_MATRIX templ = templateImage.get_view(mode);
+	CHISL_MATRIX sums = image.get_channel_integral(mode);
+
+	int const width = src.cols - templ.cols + 1;
+	int const height = src.rows - templ.rows + 1;
+
+	// the sums of each spot, from the corners of the integral image
+	CHISL_MATRIX spotSums = sums(cv::Rect(templ.cols, templ.rows, width, height)) - sums(cv::Rect(templ.cols, 0, width, height))
+		- sums(cv::Rect(0, templ.rows, width, height)) + sums(cv::Rect(0, 0, width, height));
+
+	// compare the sums instead of the means, so nothing has to be divided
+	CHISL_NUMBER const area = static_cast<CHISL_NUMBER>(templ.cols) * templ.rows;
+	cv::Scalar const mean = cv::mean(templ);
+	cv::Scalar lower;
+	cv::Scalar upper;
+	for (int i = 0; i < 4; i++)
+	{
+		lower[i] = std::floor((mean[i] - tolerance) * area);
+		upper[i] = std::ceil((mean[i] + tolerance) * area);
+	}
+
+	CHISL_MATRIX mask;
+	cv::inRange(spotSums, lower, upper, mask);
+	return mask;
+}
+
+/// <summary>
+/// Works out how well the template matches at every spot within the image, one tile per thread.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="templ"></param>
+/// <param name="candidates">If given, the tiles without a spot set within it are skipped, and scored as -1.</param>
+/// <returns>The scores, where each is for the template with its top left at that spot.</returns>
+CHISL_MATRIX match_template(const CHISL_MATRIX& image, const CHISL_MATRIX& templ, const CHISL_MATRIX& candidates = CHISL_MATRIX())
+{
+	std::vector<cv::Rect> tiles = get_match_tiles(image, templ);
+
+	CHISL_MATRIX result;
+
+	if (tiles.size() <= 1 && candidates.empty())
+	{
+		cv::matchTemplate(image, templ, result, cv::TM_CCOEFF_NORMED);
+		return result;
+	}
+
+	result.create(image.rows - templ.rows + 1, image.cols - templ.cols + 1, CV_32F);
+
+	if (!candidates.empty())
+	{
+		PrefilterCounters::get_instance().tiles += static_cast<CHISL_INT>(tiles.size());
+	}
+
+	// each tile writes to its own part of the scores
+	cv::parallel_for_(cv::Range(0, static_cast<int>(tiles.size())), [&](cv::Range const& range)
+		{
+			for (int i = range.start; i < range.end; i++)
+			{
+				CHISL_MATRIX tileResult = result(tiles[i]);
+
+				if (!candidates.empty() && cv::countNonZero(candidates(tiles[i])) == 0)
+				{
+					PrefilterCounters::get_instance().skipped++;
+					tileResult.setTo(-1.0f);
+					continue;
+				}
+
+				cv::matchTemplate(image(get_match_tile_source(tiles[i], templ)), templ, tileResult, cv::TM_CCOEFF_NORMED);
+			}
+		}, static_cast<double>(tiles.size()));
+
+	return result;
+}
+
+/// <summary>
+/// Finds the best match of the template within the whole image.
+/// Each thread finds the best match within its own tiles, then the best of those is picked.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="templ"></param>
+/// <param name="candidates">If given, the tiles without a spot set within it are skipped.</param>
+/// <returns>The top left of the best match, and how well it matched, which is below -1 if every tile was skipped.</returns>
+std::pair<CHISL_POINT, CHISL_NUMBER> match_best(const CHISL_MATRIX& image, const CHISL_MATRIX& templ, const CHISL_MATRIX& candidates = CHISL_MATRIX())
+{
+	std::vector<cv::Rect> tiles = get_match_tiles(image, templ);
+
+	if (!candidates.empty())
+	{
+		PrefilterCounters::get_instance().tiles += static_cast<CHISL_INT>(tiles.size());
+	}
+
+	std::mutex mutex;
+	CHISL_POINT bestLoc;
+	CHISL_NUMBER bestVal = -2.0;
+
+	cv::parallel_for_(cv::Range(0, static_cast<int>(tiles.size())), [&](cv::Range const& range)
+		{
+			CHISL_MATRIX result;
+			CHISL_POINT rangeLoc;
+			CHISL_NUMBER rangeVal = -2.0;
+
+			for (int i = range.start; i < range.end; i++)
+			{
+				if (!candidates.empty() && cv::countNonZero(candidates(tiles[i])) == 0)
+				{
+					PrefilterCounters::get_instance().skipped++;
+					continue;
+				}
+
+				cv::matchTemplate(image(get_match_tile_source(tiles[i], templ)), templ, result, cv::TM_CCOEFF_NORMED);
+
+				CHISL_NUMBER maxVal;
+				CHISL_POINT maxLoc;
+				cv::minMaxLoc(result, nullptr, &maxVal, nullptr, &maxLoc);
+
+				if (maxVal > rangeVal)
+				{
+					rangeVal = maxVal;
+					rangeLoc = tiles[i].tl() + maxLoc;
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (rangeVal > bestVal)
+			{
+				bestVal = rangeVal;
+				bestLoc = rangeLoc;
+			}
+		}, static_cast<double>(tiles.size()));
+
+	return { bestLoc, bestVal };
+}
+
+/// <summary>
+/// Finds the best match of the template by searching shrunk copies of the image and template first,
+/// then searching around the best few spots at full size.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="smallImage">The image, halved the given number of times.</param>
+/// <param name="templ"></param>
+/// <param name="smallTemplate">The template, halved the given number of times.</param>
+/// <param name="levels">The number of times the image and template were halved.</param>
+/// <param name="candidates">The number of spots to search again at full size.</param>
+/// <returns>The top left of the best match, and how well it matched.</returns>
+std::pair<CHISL_POINT, CHISL_NUMBER> match_pyramid(const CHISL_MATRIX& image, const CHISL_MATRIX& smallImage, const CHISL_MATRIX& templ, const CHISL_MATRIX& smallTemplate, int const levels, int const candidates)
+{
+	int const factor = 1 << levels;
+
+	CHISL_MATRIX result = match_template(smallImage, smallTemplate);
+
+	cv::Rect const bounds(0, 0, image.cols, image.rows);
+	CHISL_POINT bestLoc;
+	CHISL_NUMBER bestVal = -1.0;
+
+	for (int i = 0; i < candidates; i++)
+	{
+		CHISL_NUMBER val;
+		CHISL_POINT loc;
+		cv::minMaxLoc(result, nullptr, &val, nullptr, &loc);
+
+		if (val < -1.0)
+		{
+			// no spots left
+			break;
+		}
+
+		// clear around the spot, so the next candidate is somewhere else
+		cv::rectangle(result, cv::Rect(loc.x - smallTemplate.cols / 2, loc.y - smallTemplate.rows / 2, smallTemplate.cols, smallTemplate.rows), cv::Scalar(-2.0), cv::FILLED);
+
+		// search the full size image around the spot, allowing for the rounding from shrinking
+		cv::Rect window(loc.x * factor - factor, loc.y * factor - factor, templ.cols + factor * 2, templ.rows + factor * 2);
+		window &= bounds;
+
+		if (window.width < templ.cols || window.height < templ.rows)
+		{
+			continue;
+		}
+
+		auto [windowLoc, windowVal] = match_best(image(window), templ);
+
+		if (windowVal > bestVal)
+		{
+			bestVal = windowVal;
+			bestLoc = window.tl() + windowLoc;
+		}
+	}
+
+	return { bestLoc, bestVal };
+}
+
+/// <summary>
+/// Finds identical copies of the template within the image, using rolling hashes of each row and then of each column of row hashes.
+/// Every spot costs a few operations no matter the size of the template, and only spots with the same hash are compared byte for byte.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="templ"></param>
+/// <param name="all">If false, stops at the first copy found.</param>
+/// <returns>The top left of each copy, in reading order.</returns>
+std::vector<CHISL_POINT> match_exact(const CHISL_MATRIX& image, const CHISL_MATRIX& templ, bool const all)
+{
+	if (image.type() != templ.type() || image.depth() != CV_8U)
+	{
+		throw std::invalid_argument("The image and template must have the same 8 bit type to be matched exactly.");
+	}
+
+	std::vector<CHISL_POINT> points;
+
+	int const resultWidth = image.cols - templ.cols + 1;
+	int const resultHeight = image.rows - templ.rows + 1;
+
+	if (resultWidth <= 0 || resultHeight <= 0)
+	{
+		return points;
+	}
+
+	size_t const channels = image.channels();
+	size_t const rowBytes = templ.cols * channels;
+
+	// the multipliers of the byte and row hash that leave each window, at the point they are taken out
+	uint64_t rowPower = 1;
+	for (size_t i = 0; i < rowBytes; i++)
+	{
+		rowPower *= EXACT_ROW_BASE;
+	}
+	uint64_t columnPower = 1;
+	for (int i = 1; i < templ.rows; i++)
+	{
+		columnPower *= EXACT_COLUMN_BASE;
+	}
+
+	// hashes every window of the template's width along the row, overflowing as a modulus of 2^64
+	auto hash_row = [&](uchar const* row, uint64_t* hashes, int const count)
+		{
+			uint64_t hash = 0;
+			for (size_t i = 0; i < rowBytes; i++)
+			{
+				hash = hash * EXACT_ROW_BASE + row[i];
+			}
+			hashes[0] = hash;
+
+			for (int x = 1; x < count; x++)
+			{
+				size_t start = (x - 1) * channels;
+				for (size_t c = 0; c < channels; c++)
+				{
+					hash = hash * EXACT_ROW_BASE + row[start + c + rowBytes] - row[start + c] * rowPower;
+				}
+				hashes[x] = hash;
+			}
+		};
+
+	uint64_t templateHash = 0;
+	for (int y = 0; y < templ.rows; y++)
+	{
+		uint64_t rowHash;
+		hash_row(templ.ptr<uchar>(y), &rowHash, 1);
+		templateHash = templateHash * EXACT_COLUMN_BASE + rowHash;
+	}
+
+	// the row hashes of the last template height of rows, so they can be taken back out
+	std::vector<uint64_t> rowHashes(static_cast<size_t>(templ.rows) * resultWidth);
+	std::vector<uint64_t> columnHashes(resultWidth, 0);
+
+	for (int y = 0; y < image.rows; y++)
+	{
+		uint64_t* rowHash = rowHashes.data() + static_cast<size_t>(y % templ.rows) * resultWidth;
+
+		// the row leaving the window is in the slot about to be reused
+		if (y >= templ.rows)
+		{
+			for (int x = 0; x < resultWidth; x++)
+			{
+				columnHashes[x] -= rowHash[x] * columnPower;
+			}
+		}
+
+		hash_row(image.ptr<uchar>(y), rowHash, resultWidth);
+
+		for (int x = 0; x < resultWidth; x++)
+		{
+			columnHashes[x] = columnHashes[x] * EXACT_COLUMN_BASE + rowHash[x];
+		}
+
+		int top = y - templ.rows + 1;
+		if (top < 0)
+		{
+			continue;
+		}
+
+		for (int x = 0; x < resultWidth; x++)
+		{
+			if (columnHashes[x] != templateHash)
+			{
+				continue;
+			}
+
+			// make sure it was not a collision
+			bool same = true;
+			for (int row = 0; row < templ.rows && same; row++)
+			{
+				same = std::memcmp(image.ptr<uchar>(top + row) + x * channels, templ.ptr<uchar>(row), rowBytes) == 0;
+			}
+
+			if (same)
+			{
+				points.push_back(CHISL_POINT(x, top));
+
+				if (!all)
+				{
+					return points;
+				}
+			}
+		}
+	}
+
+	return points;
+}
+
+/// <summary>
+/// Finds the pixels within the image that are the color, give or take the tolerance on each channel.
+/// Each row is compared a vector of pixels at a time, and only the vectors holding a pixel of the color are looked at pixel by pixel.
+/// </summary>
+/// <param name="image">A BGR or BGRA image.</param>
+/// <param name="blue"></param>
+/// <param name="green"></param>
+/// <param name="red"></param>
+/// <param name="tolerance"></param>
+/// <param name="limit">The most pixels to find, after which the rest of the image is not looked at.</param>
+/// <returns>Each pixel of the color, in reading order.</returns>
+std::vector<CHISL_POINT> match_color(const CHISL_MATRIX& image, uchar const blue, uchar const green, uchar const red, uchar const tolerance, size_t const limit)
+{
+	int const channels = image.channels();
+	if (image.depth() != CV_8U || (channels != 3 && channels != 4))
+	{
+		throw std::invalid_argument("The image must have 8 bit color to find a color within it.");
+	}
+
+	auto matches = [&](uchar const* pixel)
+		{
+			return std::abs(pixel[0] - blue) <= tolerance && std::abs(pixel[1] - green) <= tolerance && std::abs(pixel[2] - red) <= tolerance;
+		};
+
+	std::vector<CHISL_POINT> points;
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+	int const lanes = cv::VTraits<cv::v_uint8>::vlanes();
+	cv::v_uint8 const b = cv::vx_setall_u8(blue);
+	cv::v_uint8 const g = cv::vx_setall_u8(green);
+	cv::v_uint8 const r = cv::vx_setall_u8(red);
+	cv::v_uint8 const t = cv::vx_setall_u8(tolerance);
+#endif
+
+	for (int y = 0; y < image.rows; y++)
+	{
+		uchar const* row = image.ptr<uchar>(y);
+		int x = 0;
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+		for (; x <= image.cols - lanes; x += lanes)
+		{
+			cv::v_uint8 pb, pg, pr, pa;
+			if (channels == 3)
+			{
+				cv::v_load_deinterleave(row + x * 3, pb, pg, pr);
+			}
+			else
+			{
+				cv::v_load_deinterleave(row + x * 4, pb, pg, pr, pa);
+			}
+
+			cv::v_uint8 found = cv::v_and(cv::v_and(cv::v_le(cv::v_absdiff(pb, b), t), cv::v_le(cv::v_absdiff(pg, g), t)), cv::v_le(cv::v_absdiff(pr, r), t));
+			if (!cv::v_check_any(found))
+			{
+				continue;
+			}
+
+			for (int i = x; i < x + lanes; i++)
+			{
+				if (matches(row + i * channels))
+				{
+					points.push_back(CHISL_POINT(i, y));
+					if (points.size() >= limit) return points;
+				}
+			}
+		}
+#endif
+
+		for (; x < image.cols; x++)
+		{
+			if (matches(row + x * channels))
+			{
+				points.push_back(CHISL_POINT(x, y));
+				if (points.size() >= limit) return points;
+			}
+		}
+	}
+
+	return points;
+}
+
+/// <summary>
+/// Sums the absolute differences between two rows of bytes.
+/// </summary>
+/// <param name="a"></param>
+/// <param name="b"></param>
+/// <param name="length"></param>
+/// <returns></returns>
+uint64_t row_absolute_difference(uchar const* a, uchar const* b, int const length)
+{
+	uint64_t sum = 0;
+	int i = 0;
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+	int const lanes = cv::VTraits<cv::v_uint8>::vlanes();
+
+	for (; i <= length - lanes; i += lanes)
+	{
+		sum += cv::v_reduce_sad(cv::vx_load(a + i), cv::vx_load(b + i));
+	}
+#endif
+
+	for (; i < length; i++)
+	{
+		sum += std::abs(static_cast<int>(a[i]) - static_cast<int>(b[i]));
+	}
+
+	return sum;
+}
+
+/// <summary>
+/// Sums the squared differences between two rows of bytes.
+/// </summary>
+/// <param name="a"></param>
+/// <param name="b"></param>
+/// <param name="length"></param>
+/// <returns></returns>
+uint64_t row_squared_difference(uchar const* a, uchar const* b, int const length)
+{
+	uint64_t sum = 0;
+	int i = 0;
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+	int const lanes = cv::VTraits<cv::v_uint8>::vlanes();
+	cv::v_int32 total = cv::vx_setzero_s32();
+
+	for (; i <= length - lanes; i += lanes)
+	{
+		// differences fit within 16 bits, and each pair of their squares within 32
+		cv::v_uint16 d0, d1;
+		cv::v_expand(cv::v_absdiff(cv::vx_load(a + i), cv::vx_load(b + i)), d0, d1);
+		cv::v_int16 s0 = cv::v_reinterpret_as_s16(d0);
+		cv::v_int16 s1 = cv::v_reinterpret_as_s16(d1);
+
+		total = cv::v_add(total, cv::v_add(cv::v_dotprod(s0, s0), cv::v_dotprod(s1, s1)));
+	}
+
+	sum += static_cast<uint64_t>(cv::v_reduce_sum(total));
+#endif
+
+	for (; i < length; i++)
+	{
+		int d = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+		sum += d * d;
+	}
+
+	return sum;
+}
+
+/// <summary>
+/// Gets the difference from the template that an unrelated spot with the same spread of values would have on average,
+/// so that differences can be scored on the same scale as correlation, where unrelated spots score around 0.
+/// </summary>
+/// <param name="templ"></param>
+/// <param name="squared"></param>
+/// <returns></returns>
+CHISL_NUMBER get_unrelated_difference(const CHISL_MATRIX& templ, bool const squared)
+{
+	CHISL_MATRIX deviation;
+	cv::absdiff(templ, cv::mean(templ), deviation);
+
+	// two unrelated values differ by about twice the variance when squared, and about the square root of two times the mean deviation otherwise
+	CHISL_NUMBER difference = squared
+		? 2.0 * cv::norm(deviation, cv::NORM_L2SQR)
+		: std::sqrt(2.0) * cv::norm(deviation, cv::NORM_L1);
+
+	// a flat template would otherwise only match itself
+	return std::max(difference, static_cast<CHISL_NUMBER>(templ.total() * templ.channels()));
+}
+
+/// <summary>
+/// Gets the sum of every channel within the window, from the corners of an integral image of type T with the channels kept apart.
+/// </summary>
+/// <param name="integral"></param>
+/// <param name="window"></param>
+/// <returns></returns>
+template<typename T>
+CHISL_NUMBER get_window_sum(const CHISL_MATRIX& integral, cv::Rect const& window)
+{
+	int const channels = integral.channels();
+	int const left = window.x * channels;
+	int const right = (window.x + window.width) * channels;
+	T const* top = integral.ptr<T>(window.y);
+	T const* bottom = integral.ptr<T>(window.y + window.height);
+
+	CHISL_NUMBER sum = 0.0;
+	for (int c = 0; c < channels; c++)
+	{
+		sum += static_cast<CHISL_NUMBER>(bottom[right + c]) - top[right + c] - bottom[left + c] + top[left + c];
+	}
+
+	return sum;
+}
+
+/// <summary>
+/// Finds the spots where the template differs least from the image, by the sum of the absolute or squared differences between their pixels.
+/// The sums of each spot of the image, from an integral image, rule out most spots before any pixels are compared,
+/// and the rest stop being compared as soon as they differ by too much to pass the threshold.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="templateImage"></param>
+/// <param name="mode">The channels of the images to compare.</param>
+/// <param name="squared">If true, the differences are squared, otherwise their absolute values are used.</param>
+/// <param name="threshold">The least score to keep, where 1 is identical and around 0 is unrelated, the same as correlation.</param>
+/// <param name="all">If false, only the best spot is kept.</param>
+/// <returns>The top left and score of each spot that passed the threshold.</returns>
+std::vector<std::pair<CHISL_POINT, CHISL_NUMBER>> match_difference(Image const& image, Image const& templateImage, ColorMode const mode, bool const squared, CHISL_NUMBER const threshold, bool const all)
+{
+	CHISL_MATRIX const src = image.get_view(mode);
+	CHISL_MATRIX const templ = templateImage.get_view(mode);
+
+	if (src.type() != templ.type() || src.depth() != CV_8U)
+	{
+		throw std::invalid_argument("The image and template must have the same 8 bit type to be matched by difference.");
+	}
+
+	std::vector<std::pair<CHISL_POINT, CHISL_NUMBER>> spots;
+
+	std::vector<cv::Rect> tiles = get_match_tiles(src, templ);
+	if (tiles.empty())
+	{
+		return spots;
+	}
+
+	int const channels = src.channels();
+	int const rowBytes = templ.cols * channels;
+	CHISL_NUMBER const unrelatedDifference = get_unrelated_difference(templ, squared);
+	CHISL_NUMBER const allowed = (1.0 - std::clamp(threshold, 0.0, 1.0)) * unrelatedDifference;
+
+	// the difference is at least the difference of the sums, or of the norms when squared,
+	// so only the integral image that the method needs is used, and the plain sums are the ones kept on the image
+	CHISL_MATRIX const sums = squared ? image.get_squared_integral(mode) : image.get_channel_integral(mode);
+	auto const [templateSum, templateNorm] = templateImage.get_statistics(mode);
+
+	auto window_sum = [&](int const x, int const y)
+		{
+			cv::Rect const window(x, y, templ.cols, templ.rows);
+			return sums.depth() == CV_32S ? get_window_sum<int>(sums, window) : get_window_sum<double>(sums, window);
+		};
+
+	std::mutex mutex;
+
+	cv::parallel_for_(cv::Range(0, static_cast<int>(tiles.size())), [&](cv::Range const& range)
+		{
+			std::vector<std::pair<CHISL_POINT, CHISL_NUMBER>> found;
+			// when only the best is kept, anything worse than it can be skipped
+			CHISL_NUMBER limit = allowed;
+
+			for (int i = range.start; i < range.end; i++)
+			{
+				cv::Rect const& tile = tiles[i];
+
+				for (int y = tile.y; y < tile.y + tile.height; y++)
+				{
+					for (int x = tile.x; x < tile.x + tile.width; x++)
+					{
+						CHISL_NUMBER bound;
+						if (squared)
+						{
+							CHISL_NUMBER d = std::sqrt(std::max(window_sum(x, y), 0.0)) - templateNorm;
+							bound = d * d;
+						}
+						else
+						{
+							bound = std::abs(window_sum(x, y) - templateSum);
+						}
+
+						if (bound > limit)
+						{
+							continue;
+						}
+
+						CHISL_NUMBER difference = 0.0;
+						for (int row = 0; row < templ.rows && difference <= limit; row++)
+						{
+							uchar const* a = src.ptr<uchar>(y + row) + x * channels;
+							uchar const* b = templ.ptr<uchar>(row);
+							difference += static_cast<CHISL_NUMBER>(squared ? row_squared_difference(a, b, rowBytes) : row_absolute_difference(a, b, rowBytes));
+						}
+
+						if (difference > limit)
+						{
+							continue;
+						}
+
+						std::pair<CHISL_POINT, CHISL_NUMBER> spot{ CHISL_POINT(x, y), 1.0 - difference / unrelatedDifference };
+
+						if (all)
+						{
+							found.push_back(spot);
+						}
+						else
+						{
+							found = { spot };
+							limit = difference;
+						}
+					}
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (all)
+			{
+				spots.insert(spots.end(), found.begin(), found.end());
+			}
+			else if (!found.empty() && (spots.empty() || found.front().second > spots.front().second))
+			{
+				spots = found;
+			}
+		}, static_cast<double>(tiles.size()));
+
+	return spots;
+}
+
+/// <summary>
+/// Gets the number of times the template can be halved for a coarse search, up to the given number,
+/// so that it stays recognizable.
+/// </summary>
+/// <param name="templ"></param>
+/// <param name="levels"></param>
+/// <returns></returns>
+int get_pyramid_levels(const CHISL_MATRIX& templ, int const levels)
+{
+	int result = levels;
+	while (result > 0 && (std::min(templ.cols, templ.rows) >> result) < MIN_PYRAMID_TEMPLATE_SIZE)
+	{
+		result--;
+	}
+	return result;
+}
+
+/// <summary>
+/// Gets each scale the template is searched at, from smallest to largest.
+/// </summary>
+/// <param name="options"></param>
+/// <returns></returns>
+std::vector<CHISL_NUMBER> get_find_scales(FindOptions const& options)
+{
+	CHISL_NUMBER const smallest = std::min(options.scaleMin, options.scaleMax);
+	CHISL_NUMBER const largest = std::max(options.scaleMin, options.scaleMax);
+
+	std::vector<CHISL_NUMBER> scales;
+	for (int i = 0; smallest + i * options.scaleStep < largest; i++)
+	{
+		scales.push_back(smallest + i * options.scaleStep);
+	}
+	scales.push_back(largest);
+
+	return scales;
+}
+
+/// <summary>
+/// Gets the number of times the image and each scale of the template are halved to score the scales against each other.
+/// They are always halved at least once, if the smallest scale of the template allows it, so scoring every scale stays cheap.
+/// </summary>
+/// <param name="templateImage"></param>
+/// <param name="scales"></param>
+/// <param name="options"></param>
+/// <returns></returns>
+int get_scale_levels(Image const& templateImage, std::vector<CHISL_NUMBER> const& scales, FindOptions const& options)
+{
+	return get_pyramid_levels(templateImage.get_scaled(scales.front()).get_view(options.color), std::max(options.pyramid, 1));
+}
+
+/// <summary>
+/// Works out the images and statistics that finding the template with the given options will need,
+/// so they are ready before the first Find. When searching a range of scales, the copies at each scale are
+/// left to the first Find, since most of them are never the one the template is found at.
+/// </summary>
+/// <param name="templateImage"></param>
+/// <param name="options"></param>
+void prepare_template(Image const& templateImage, FindOptions const& options)
+{
+	std::vector<CHISL_NUMBER> scales = get_find_scales(options);
+	if (scales.size() == 1)
+	{
+		Image scaled = templateImage.get_scaled(scales.front());
+		CHISL_MATRIX templ = scaled.get_view(options.color);
+
+		int levels = get_pyramid_levels(templ, options.pyramid);
+		if (levels > 0)
+		{
+			scaled.get_view(options.color, levels);
+		}
+
+		if (options.method == FindMethod::Absolute || options.method == FindMethod::Squared)
+		{
+			scaled.get_statistics(options.color);
+		}
+	}
+
+	if (options.method == FindMethod::Features)
+	{
+		templateImage.get_features(options.color, FEATURE_TEMPLATE_POINTS);
+	}
+}
+
+/// <summary>
+/// Counts how often searching near the last match of a template found it again.
+/// </summary>
+struct NearbyCounters
+{
+	std::atomic<CHISL_INT> hits = 0;
+	std::atomic<CHISL_INT> misses = 0;
+
+	static NearbyCounters& get_instance()
+	{
+		static NearbyCounters counters;
+		return counters;
+	}
+};
+
+/// <summary>
+/// Finds the best spot for the template within the image, with the method from the options.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="templateImage"></param>
+/// <param name="threshold"></param>
+/// <param name="options"></param>
+/// <returns>The top left of the best spot and how well it matched, or nothing if no spot reached the threshold.</returns>
+std::optional<std::pair<CHISL_POINT, CHISL_NUMBER>> find_best(Image const& image, Image const& templateImage, CHISL_NUMBER const threshold, FindOptions const& options)
+{
+	CHISL_MATRIX src = image.get_view(options.color);
+	CHISL_MATRIX templ = templateImage.get_view(options.color);
+
+	// UI elements tend to stay put, so look where the template was last time first
+	if (options.nearby > 0)
+	{
+		FindOptions wholeOptions = options;
+		wholeOptions.nearby = 0;
+
+		// kept by the size of the whole screen or image, and relative to it, so finding within other images or areas does not move it
+		CHISL_POINT const whole = image.get_whole_size();
+		CHISL_POINT const offset = image.get_offset();
+
+		std::optional<CHISL_POINT> last = templateImage.get_last_match(whole);
+		if (last.has_value())
+		{
+			cv::Rect window(last.value() - offset - CHISL_POINT(options.nearby, options.nearby), cv::Size(templ.cols + options.nearby * 2, templ.rows + options.nearby * 2));
+			window &= cv::Rect(0, 0, src.cols, src.rows);
+
+			if (window.width >= templ.cols && window.height >= templ.rows)
+			{
+				// the window is too small to be worth a coarse search
+				FindOptions windowOptions = wholeOptions;
+				windowOptions.pyramid = 0;
+
+				// a weak match nearby may only be the best of a small window, while a better one is elsewhere
+				std::optional<std::pair<CHISL_POINT, CHISL_NUMBER>> found = find_best(Image(src(window)), templateImage, std::max(NEARBY_MIN_SCORE, threshold), windowOptions);
+				if (found.has_value())
+				{
+					NearbyCounters::get_instance().hits++;
+					found.value().first += window.tl();
+					templateImage.set_last_match(whole, found.value().first + offset);
+					return found;
+				}
+			}
+
+			NearbyCounters::get_instance().misses++;
+		}
+
+		std::optional<std::pair<CHISL_POINT, CHISL_NUMBER>> found = find_best(image, templateImage, threshold, wholeOptions);
+		if (found.has_value())
+		{
+			templateImage.set_last_match(whole, found.value().first + offset);
+		}
+		return found;
+	}
+
+	// only identical copies can reach a threshold of 1, so there is no need to correlate
+	if (options.method == FindMethod::Exact || threshold >= 1.0)
+	{
+		std::vector<CHISL_POINT> points = match_exact(src, templ, false);
+
+		if (points.empty())
+		{
+			return std::nullopt;
+		}
+
+		return std::make_pair(points.front(), 1.0);
+	}
+
+	if (options.method == FindMethod::Absolute || options.method == FindMethod::Squared)
+	{
+		std::vector<std::pair<CHISL_POINT, CHISL_NUMBER>> spots = match_difference(image, templateImage, options.color, options.method == FindMethod::Squared, threshold, false);
+
+		if (spots.empty())
+		{
+			return std::nullopt;
+		}
+
+		return spots.front();
+	}
+
+	int levels = get_pyramid_levels(templ, options.pyramid);
+
+	auto [maxLoc, maxVal] = levels > 0
+		? match_pyramid(src, image.get_view(options.color, levels), templ, templateImage.get_view(options.color, levels), levels, options.candidates)
+		: match_best(src, templ, options.prefilter > 0.0 ? get_prefilter_mask(image, templateImage, options.color, options.prefilter) : CHISL_MATRIX());
+
+	if (maxVal < threshold)
+	{
+		return std::nullopt;
+	}
+
+	return std::make_pair(maxLoc, maxVal);
+}
+
+/// <summary>
+/// Finds the template within the image by matching the keypoints of each, then working out where the template
+/// was moved, scaled and turned to by the keypoints that agree with each other. The keypoints of the template are found once,
+/// and the keypoints of the image are found once and shared by every template found within it.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="templateImage"></param>
+/// <param name="threshold">The least fraction of the matched keypoints that must agree on where the template is.</param>
+/// <param name="mode"></param>
+/// <returns>The rectangle around the template within the image and the fraction of the keypoints that agreed, or nothing if it was not found.</returns>
+std::optional<std::pair<Match, CHISL_NUMBER>> match_features(Image const& image, Image const& templateImage, CHISL_NUMBER const threshold, ColorMode const mode)
+{
+	std::shared_ptr<ImageFeatures const> templateFeatures = templateImage.get_features(mode, FEATURE_TEMPLATE_POINTS);
+	std::shared_ptr<ImageFeatures const> imageFeatures = image.get_features(mode, FEATURE_IMAGE_POINTS);
+
+	if (templateFeatures->keypoints.size() < static_cast<size_t>(FEATURE_MIN_MATCHES) || imageFeatures->keypoints.size() < static_cast<size_t>(FEATURE_MIN_MATCHES))
+	{
+		return std::nullopt;
+	}
+
+	std::vector<std::vector<cv::DMatch>> pairs;
+	cv::BFMatcher matcher(cv::NORM_HAMMING);
+	matcher.knnMatch(templateFeatures->descriptors, imageFeatures->descriptors, pairs, 2);
+
+	// only keep the keypoints that match one spot much better than any other
+	std::vector<cv::Point2f> templatePoints;
+	std::vector<cv::Point2f> imagePoints;
+	for (std::vector<cv::DMatch> const& pair : pairs)
+	{
+		if (pair.size() == 2 && pair[0].distance < FEATURE_RATIO * pair[1].distance)
+		{
+			templatePoints.push_back(templateFeatures->keypoints[pair[0].queryIdx].pt);
+			imagePoints.push_back(imageFeatures->keypoints[pair[0].trainIdx].pt);
+		}
+	}
+
+	if (templatePoints.size() < static_cast<size_t>(FEATURE_MIN_MATCHES))
+	{
+		return std::nullopt;
+	}
+
+	std::vector<uchar> inliers;
+	CHISL_MATRIX homography = cv::findHomography(templatePoints, imagePoints, cv::RANSAC, FEATURE_REPROJECTION_ERROR, inliers);
+	if (homography.empty())
+	{
+		return std::nullopt;
+	}
+
+	int agreed = cv::countNonZero(inliers);
+	CHISL_NUMBER score = static_cast<CHISL_NUMBER>(agreed) / templatePoints.size();
+	if (agreed < FEATURE_MIN_MATCHES || score < threshold)
+	{
+		return std::nullopt;
+	}
+
+	std::vector<cv::Point2f> corners{
+		{ 0.0f, 0.0f },
+		{ static_cast<float>(templateImage.get_width()), 0.0f },
+		{ static_cast<float>(templateImage.get_width()), static_cast<float>(templateImage.get_height()) },
+		{ 0.0f, static_cast<float>(templateImage.get_height()) },
+	};
+	std::vector<cv::Point2f> projected;
+	cv::perspectiveTransform(corners, projected, homography);
+
+	// a twisted outline means the keypoints agreed by chance
+	if (!cv::isContourConvex(projected))
+	{
+		return std::nullopt;
+	}
+
+	cv::Rect rect = cv::boundingRect(projected) & cv::Rect(0, 0, image.get_width(), image.get_height());
+	if (rect.empty())
+	{
+		return std::nullopt;
+	}
+
+	return std::make_pair(Match(CHISL_POINT(rect.width, rect.height), rect.tl()), score);
+}
+
+/// <summary>
+/// Finds the best match for the template within the image, at any of the scales from the options.
+/// The scale the template was last found at within an image of the same size is searched first, since the same display
+/// keeps the same scale. Otherwise every scale is scored on shrunk copies of the images, and the best few are searched at full size,
+/// best first, until the rest score too far below the best match so far.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="templateImage"></param>
+/// <param name="threshold"></param>
+/// <param name="options"></param>
+/// <returns>The best match and how well it matched, or nothing if no spot reached the threshold.</returns>
+std::optional<std::pair<Match, CHISL_NUMBER>> find_best_scaled(Image const& image, Image const& templateImage, CHISL_NUMBER const threshold, FindOptions const& options)
+{
+	// keypoints are found at any scale, so there is no need to search each one
+	if (options.method == FindMethod::Features)
+	{
+		return match_features(image, templateImage, threshold, options.color);
+	}
+
+	// areas of a display keep the scale of the whole display
+	CHISL_POINT const display = image.get_whole_size();
+
+	auto search = [&](CHISL_NUMBER const scale) -> std::optional<std::pair<Match, CHISL_NUMBER>>
+		{
+			Image scaled = templateImage.get_scaled(scale);
+			if (scaled.get_width() > image.get_width() || scaled.get_height() > image.get_height())
+			{
+				return std::nullopt;
+			}
+
+			std::optional<std::pair<CHISL_POINT, CHISL_NUMBER>> found = find_best(image, scaled, threshold, options);
+			if (!found.has_value())
+			{
+				return std::nullopt;
+			}
+
+			templateImage.set_found_scale(display, scale);
+			return std::make_pair(Match(scaled.get_size(), found.value().first), found.value().second);
+		};
+
+	std::vector<CHISL_NUMBER> scales = get_find_scales(options);
+	if (scales.size() == 1)
+	{
+		return search(scales.front());
+	}
+
+	std::optional<CHISL_NUMBER> known = templateImage.get_found_scale(display);
+	if (known.has_value())
+	{
+		std::optional<std::pair<Match, CHISL_NUMBER>> found = search(known.value());
+		if (found.has_value())
+		{
+			return found;
+		}
+	}
+
+	// score every scale on shrunk copies, which is cheap compared to searching one at full size
+	int levels = get_scale_levels(templateImage, scales, options);
+	CHISL_MATRIX smallImage = image.get_view(options.color, levels);
+
+	std::vector<std::pair<CHISL_NUMBER, CHISL_NUMBER>> scored;
+	for (CHISL_NUMBER const scale : scales)
+	{
+		if (known.has_value() && std::abs(scale - known.value()) < 0.0005)
+		{
+			// already searched
+			continue;
+		}
+
+		CHISL_MATRIX smallTemplate = templateImage.get_scaled(scale).get_view(options.color, levels);
+		if (smallTemplate.cols > smallImage.cols || smallTemplate.rows > smallImage.rows)
+		{
+			continue;
+		}
+
+		scored.emplace_back(scale, match_best(smallImage, smallTemplate).second);
+	}
+
+	std::sort(scored.begin(), scored.end(), [](auto const& a, auto const& b)
+		{
+			return a.second > b.second;
+		});
+
+	std::optional<std::pair<Match, CHISL_NUMBER>> best;
+	CHISL_NUMBER bestScale = 1.0;
+	int searched = 0;
+
+	for (auto const& [scale, score] : scored)
+	{
+		// the rest scored even worse, so they are not worth searching at full size
+		if (searched >= options.candidates || (best.has_value() && score < best.value().second - SCALE_PRUNE_MARGIN))
+		{
+			break;
+		}
+		searched++;
+
+		std::optional<std::pair<Match, CHISL_NUMBER>> found = search(scale);
+		if (found.has_value() && (!best.has_value() || found.value().second > best.value().second))
+		{
+			best = found;
+			bestScale = scale;
+		}
+	}
+
+	// searching each scale remembers it when found, so remember the best one
+	if (best.has_value())
+	{
+		templateImage.set_found_scale(display, bestScale);
+	}
+
+	// only keep the copies at scales the template has been found at
+	templateImage.drop_unfound_scales();
+
+	return best;
+}
+
+/// <summary>
+/// Finds a template image within an image.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="templateImage"></param>
+/// <param name="threshold"></param>
+/// <param name="options"></param>
+/// <returns></returns>
+std::optional<Match> find(Image const& image, Image& templateImage, CHISL_NUMBER const threshold, FindOptions const& options)
+{
+	try {
+		std::optional<std::pair<Match, CHISL_NUMBER>> best = find_best_scaled(image, templateImage, threshold, options);
+		if (!best.has_value())
+		{
+			return std::nullopt;
+		}
+
+		return best.value().first;
+	}
+	catch (const cv::Exception& ex) {
+		std::cerr << "OpenCV exception: " << ex.what() << std::endl;
+		return std::nullopt;
+	}
+	catch (const std::exception& ex) {
+		std::cerr << "Standard exception: " << ex.what() << std::endl;
+		return std::nullopt;
+	}
+	catch (...) {
+		std::cerr << "Unknown exception occurred." << std::endl;
+		return std::nullopt;
+	}
+}
+
+/// <summary>
+/// Finds the best match of each of the templates within the image.
+/// The converted copies of the image are worked out once and shared by every template. When there are enough templates
+/// to keep every thread busy, the templates are searched at once, otherwise each one is split into tiles as usual.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="templates"></param>
+/// <param name="threshold"></param>
+/// <param name="options"></param>
+/// <returns>The match of each template and how well it matched, or nothing for the templates that were not found.</returns>
+std::vector<std::optional<std::pair<Match, CHISL_NUMBER>>> find_each(Image const& image, std::vector<Image> const& templates, CHISL_NUMBER const threshold, FindOptions const& options)
+{
+	std::vector<std::optional<std::pair<Match, CHISL_NUMBER>>> results(templates.size());
+
+	image.get_view(options.color);
+
+	auto search = [&](size_t const i) {
+		try {
+			results[i] = find_best_scaled(image, templates[i], threshold, options);
+		}
+		catch (const cv::Exception& ex) {
+			std::cerr << "OpenCV exception: " << ex.what() << std::endl;
+		}
+		catch (const std::exception& ex) {
+			std::cerr << "Standard exception: " << ex.what() << std::endl;
+		}
+		catch (...) {
+			std::cerr << "Unknown exception occurred." << std::endl;
+		}
+		};
+
+	if (templates.size() >= static_cast<size_t>(cv::getNumThreads()))
+	{
+		cv::parallel_for_(cv::Range(0, static_cast<int>(templates.size())), [&](cv::Range const& range)
+			{
+				for (int i = range.start; i < range.end; i++)
+				{
+					search(i);
+				}
+			});
+	}
+	else
+	{
+		for (size_t i = 0; i < templates.size(); i++)
+		{
+			search(i);
+		}
+	}
+
+	return results;
+}
+
+/// <summary>
+/// Finds the rectangles within the grayscale matrix that probably contain text, in reading order.
+/// </summary>
+/// <param name="gray"></param>
+/// <returns></returns>
+std::vector<cv::Rect> find_text_regions(const CHISL_MATRIX& gray)
+{
+	// glyphs have strong edges, where images, gradients and whitespace mostly do not
+	CHISL_MATRIX gradient;
+	cv::morphologyEx(gray, gradient, cv::MORPH_GRADIENT, cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3)));
+
+	CHISL_MATRIX edges;
+	CHISL_NUMBER edgeThreshold = cv::threshold(gradient, edges, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+
+	// mostly flat images give a low threshold, which would pick up noise
+	if (edgeThreshold < TEXT_REGION_MIN_EDGE)
+	{
+		cv::threshold(gradient, edges, TEXT_REGION_MIN_EDGE, 255, cv::THRESH_BINARY);
+	}
+
+	// join the glyphs on each line together
+	CHISL_MATRIX joined;
+	cv::morphologyEx(edges, joined, cv::MORPH_CLOSE, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(9, 3)));
+
+	std::vector<std::vector<CHISL_POINT>> contours;
+	cv::findContours(joined, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+	cv::Rect const bounds(0, 0, gray.cols, gray.rows);
+	std::vector<cv::Rect> regions;
+
+	for (auto const& contour : contours)
+	{
+		cv::Rect rect = cv::boundingRect(contour);
+
+		// too small to hold a glyph
+		if (rect.width < 4 || rect.height < 6)
+		{
+			continue;
+		}
+
+		// text fills a fair amount of its box with edges, unlike lines and borders
+		CHISL_NUMBER fill = static_cast<CHISL_NUMBER>(cv::countNonZero(edges(rect))) / rect.area();
+		if (fill < 0.1)
+		{
+			continue;
+		}
+
+		// leave room around the text, which the engine reads better with
+		rect.x -= TEXT_REGION_PADDING;
+		rect.y -= TEXT_REGION_PADDING;
+		rect.width += TEXT_REGION_PADDING * 2;
+		rect.height += TEXT_REGION_PADDING * 2;
+		regions.push_back(rect & bounds);
+	}
+
+	// merge overlapping regions, so no text is read twice
+	bool merged = true;
+	while (merged)
+	{
+		merged = false;
+
+		for (size_t i = 0; i < regions.size() && !merged; i++)
+		{
+			for (size_t j = i + 1; j < regions.size(); j++)
+			{
+				if ((regions[i] & regions[j]).area() > 0)
+				{
+					regions[i] |= regions[j];
+					regions.erase(regions.begin() + j);
+					merged = true;
+					break;
+				}
+			}
+		}
+	}
+
+	std::sort(regions.begin(), regions.end(), [](cv::Rect const& a, cv::Rect const& b) {
+		return a.y != b.y ? a.y < b.y : a.x < b.x;
+		});
+
+	return regions;
+}
+
+/// <summary>
+/// Separates the glyphs within the grayscale matrix from its background.
+/// </summary>
+/// <param name="gray"></param>
+/// <returns>The glyphs in white, on black.</returns>
+CHISL_MATRIX get_glyph_foreground(const CHISL_MATRIX& gray)
+{
+	bool invert;
+	int threshold = otsu_threshold(gray, invert);
+
+	CHISL_MATRIX foreground;
+	cv::threshold(gray, foreground, threshold, 255, invert ? cv::THRESH_BINARY : cv::THRESH_BINARY_INV);
+
+	return foreground;
+}
+
+/// <summary>
+/// Finds the runs of rows or columns of the foreground that have ink in them.
+/// </summary>
+/// <param name="foreground"></param>
+/// <param name="columns">If true, the runs of columns are found, otherwise the runs of rows.</param>
+/// <returns>The runs, in order.</returns>
+std::vector<cv::Range> find_ink_spans(const CHISL_MATRIX& foreground, bool const columns)
+{
+	CHISL_MATRIX ink;
+	cv::reduce(foreground, ink, columns ? 0 : 1, cv::REDUCE_MAX);
+
+	int const length = static_cast<int>(ink.total());
+
+	std::vector<cv::Range> spans;
+	int start = -1;
+	for (int i = 0; i <= length; i++)
+	{
+		bool const set = i < length && ink.at<uchar>(i);
+
+		if (set && start < 0)
+		{
+			start = i;
+		}
+		else if (!set && start >= 0)
+		{
+			spans.emplace_back(start, i);
+			start = -1;
+		}
+	}
+
+	return spans;
+}
+
+/// <summary>
+/// Learns the glyphs of a fixed font from a sample image of the given characters, written left to right.
+/// </summary>
+/// <param name="sample"></param>
+/// <param name="characters">The characters within the sample, in order. Spaces are ignored.</param>
+/// <returns>The glyph set, or nothing if the sample does not hold one glyph per character.</returns>
+std::optional<GlyphSet> learn_glyphs(Image const& sample, CHISL_STRING const& characters)
+{
+	CHISL_MATRIX gray = sample.get_view(ColorMode::Gray);
+	CHISL_MATRIX foreground = get_glyph_foreground(gray);
+
+	// split the sample at the columns without any glyph in them
+	std::vector<cv::Range> spans = find_ink_spans(foreground, true);
+
+	GlyphSet glyphSet;
+	for (char const c : characters)
+	{
+		if (!std::isspace(static_cast<unsigned char>(c)))
+		{
+			glyphSet.characters.push_back(c);
+		}
+	}
+
+	if (spans.empty() || glyphSet.characters.empty())
+	{
+		std::cerr << "Found no glyphs to learn in the sample.\n";
+		return std::nullopt;
+	}
+
+	// glyphs such as '"' and '%' have gaps of their own, which are clearly narrower than the gaps between glyphs,
+	// so only those are joined, and any other extra spans are left to be reported below
+	if (spans.size() > glyphSet.characters.size())
+	{
+		std::vector<int> sampleGaps;
+		for (size_t i = 1; i < spans.size(); i++)
+		{
+			sampleGaps.push_back(spans.at(i).start - spans.at(i - 1).end);
+		}
+
+		std::nth_element(sampleGaps.begin(), sampleGaps.begin() + sampleGaps.size() / 2, sampleGaps.end());
+		CHISL_NUMBER const splitGap = sampleGaps.at(sampleGaps.size() / 2) * GLYPH_SPLIT_GAP;
+
+		while (spans.size() > glyphSet.characters.size())
+		{
+			size_t narrowest = 1;
+			for (size_t i = 2; i < spans.size(); i++)
+			{
+				if (spans.at(i).start - spans.at(i - 1).end < spans.at(narrowest).start - spans.at(narrowest - 1).end)
+				{
+					narrowest = i;
+				}
+			}
+
+			if (spans.at(narrowest).start - spans.at(narrowest - 1).end >= splitGap)
+			{
+				break;
+			}
+
+			spans.at(narrowest - 1).end = spans.at(narrowest).end;
+			spans.erase(spans.begin() + narrowest);
+		}
+	}
+
+	if (spans.size() != glyphSet.characters.size())
+	{
+		std::cerr << "Found " << spans.size() << " glyphs in the sample, but expected " << glyphSet.characters.size() << ".\n";
+		return std::nullopt;
+	}
+
+	cv::Rect const bounds(0, 0, gray.cols, gray.rows);
+	std::vector<int> widths;
+	std::vector<int> gaps;
+
+	for (size_t i = 0; i < spans.size(); i++)
+	{
+		cv::Range const& span = spans.at(i);
+
+		cv::Rect rect = cv::boundingRect(foreground(cv::Range::all(), span));
+		rect.x += span.start;
+
+		// keep some background, so flat glyphs such as '.' and '-' still have an edge to match
+		rect.x -= GLYPH_PADDING;
+		rect.y -= GLYPH_PADDING;
+		rect.width += GLYPH_PADDING * 2;
+		rect.height += GLYPH_PADDING * 2;
+		rect &= bounds;
+
+		glyphSet.glyphs.push_back(gray(rect).clone());
+		glyphSet.height = std::max(glyphSet.height, rect.height);
+
+		widths.push_back(span.size());
+		if (i > 0)
+		{
+			gaps.push_back(span.start - spans.at(i - 1).end);
+		}
+	}
+
+	// anything wider than the usual gap by half of a glyph is a space
+	std::sort(widths.begin(), widths.end());
+	std::sort(gaps.begin(), gaps.end());
+	int gap = gaps.empty() ? 1 : gaps.at(gaps.size() / 2);
+	glyphSet.spaceWidth = gap + std::max(widths.at(widths.size() / 2) / 2, 1);
+
+	return glyphSet;
+}
+
+/// <summary>
+/// Reads the text written with the glyph set within the image.
+/// The image is split into lines at the rows without ink, and each line is scanned left to right,
+/// matching the glyphs of about the right size against each run of columns with ink.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="glyphSet"></param>
+/// <param name="level">Symbols are read one by one, words are split by spaces, and everything else is read by line.</param>
+/// <param name="threshold">The minimum match for a glyph, from 0 to 1.</param>
+/// <returns>The text, and the Matches of where they are within the image.</returns>
+std::vector<std::pair<CHISL_STRING, Match>> read_glyphs(Image const& image, GlyphSet const& glyphSet, tesseract::PageIteratorLevel const level, CHISL_NUMBER const threshold)
+{
+	CHISL_MATRIX gray = image.get_view(ColorMode::Gray);
+	CHISL_MATRIX foreground = get_glyph_foreground(gray);
+	cv::Rect const bounds(0, 0, gray.cols, gray.rows);
+
+	int widest = 0;
+	for (CHISL_MATRIX const& glyph : glyphSet.glyphs)
+	{
+		widest = std::max(widest, glyph.cols);
+	}
+
+	struct Glyph
+	{
+		cv::Rect rect;
+		char character;
+	};
+
+	std::vector<std::vector<Glyph>> lines;
+
+	for (cv::Range const& rows : find_ink_spans(foreground, false))
+	{
+		CHISL_MATRIX band = foreground(rows, cv::Range::all());
+		std::vector<cv::Range> spans = find_ink_spans(band, true);
+		std::vector<Glyph> line;
+
+		for (size_t i = 0; i < spans.size();)
+		{
+			std::optional<Glyph> best;
+			CHISL_NUMBER bestScore = threshold;
+			size_t next = i + 1;
+
+			// glyphs such as '"' and '%' have gaps of their own, so the runs that start here are joined with the next ones while a glyph could still cover them
+			for (size_t j = i; j < spans.size() && spans.at(j).end - spans.at(i).start + GLYPH_PADDING * 2 <= widest + GLYPH_SLACK; j++)
+			{
+				cv::Range const columns(spans.at(i).start, spans.at(j).end);
+
+				cv::Rect rect = cv::boundingRect(band(cv::Range::all(), columns));
+				rect.x += columns.start - GLYPH_PADDING;
+				rect.y += rows.start - GLYPH_PADDING;
+				rect.width += GLYPH_PADDING * 2;
+				rect.height += GLYPH_PADDING * 2;
+
+				cv::Rect const window = cv::Rect(rect.x - GLYPH_SLACK, rect.y - GLYPH_SLACK, rect.width + GLYPH_SLACK * 2, rect.height + GLYPH_SLACK * 2) & bounds;
+
+				for (size_t k = 0; k < glyphSet.glyphs.size(); k++)
+				{
+					CHISL_MATRIX const& glyph = glyphSet.glyphs.at(k);
+
+					// only glyphs that would cover the ink are tried, so '.' is not found within '8'
+					if (std::abs(glyph.cols - rect.width) > GLYPH_SLACK || std::abs(glyph.rows - rect.height) > GLYPH_SLACK
+						|| glyph.cols > window.width || glyph.rows > window.height)
+					{
+						continue;
+					}
+
+					CHISL_MATRIX result = match_template(gray(window), glyph);
+
+					double score;
+					CHISL_POINT point;
+					cv::minMaxLoc(result, nullptr, &score, nullptr, &point);
+
+					if (score >= bestScore)
+					{
+						best = Glyph{ cv::Rect(window.tl() + point, glyph.size()), glyphSet.characters.at(k) };
+						bestScore = score;
+						next = j + 1;
+					}
+				}
+			}
+
+			if (best.has_value())
+			{
+				line.push_back(best.value());
+			}
+
+			i = next;
+		}
+
+		if (!line.empty())
+		{
+			lines.push_back(line);
+		}
+	}
+
+	std::vector<std::pair<CHISL_STRING, Match>> results;
+
+	for (std::vector<Glyph> const& line : lines)
+	{
+		CHISL_STRING lineText;
+		cv::Rect lineRect = line.front().rect;
+		CHISL_STRING wordText;
+		cv::Rect wordRect = line.front().rect;
+
+		for (size_t i = 0; i < line.size(); i++)
+		{
+			Glyph const& glyph = line.at(i);
+
+			if (level == tesseract::RIL_SYMBOL)
+			{
+				results.emplace_back(CHISL_STRING(1, glyph.character), Match(CHISL_POINT(glyph.rect.width, glyph.rect.height), glyph.rect.tl()));
+				continue;
+			}
+
+			if (i > 0 && glyph.rect.x - line.at(i - 1).rect.br().x > glyphSet.spaceWidth)
+			{
+				if (level == tesseract::RIL_WORD)
+				{
+					results.emplace_back(wordText, Match(CHISL_POINT(wordRect.width, wordRect.height), wordRect.tl()));
+				}
+
+				lineText += ' ';
+				wordText.clear();
+				wordRect = glyph.rect;
+			}
+
+			lineText += glyph.character;
+			wordText += glyph.character;
+			wordRect |= glyph.rect;
+			lineRect |= glyph.rect;
+		}
+
+		if (level == tesseract::RIL_WORD)
+		{
+			results.emplace_back(wordText, Match(CHISL_POINT(wordRect.width, wordRect.height), wordRect.tl()));
+		}
+		else if (level != tesseract::RIL_SYMBOL)
+		{
+			results.emplace_back(lineText, Match(CHISL_POINT(lineRect.width, lineRect.height), lineRect.tl()));
+		}
+	}
+
+	return results;
+}
+
+/// <summary>
+/// Gets the folder that holds the model for the given profile.
+/// </summary>
+/// <param name="profile"></param>
+/// <returns></returns>
+CHISL_STRING get_text_model_path(TextProfile const& profile)
+{
+	CHISL_STRING path = get_path().append("/").append(profile.model);
+
+	if (profile.model != DEFAULT_TEXT_MODEL && !std::filesystem::exists(path + "/eng.traineddata"))
+	{
+		// every engine for the profile is created through here, so only warn the first time
+		static std::mutex mutex;
+		static std::unordered_set<CHISL_STRING> warned;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (warned.insert(profile.model).second)
+		{
+			std::cerr << "Text model \"" << profile.model << "\" not found. Using \"" DEFAULT_TEXT_MODEL "\" instead.\n";
+		}
+
+		return get_path().append("/" DEFAULT_TEXT_MODEL);
+	}
+
+	return path;
+}
+
+/// <summary>
+/// Creates and initializes an OCR engine for the given profile.
+/// </summary>
+/// <param name="profile"></param>
+/// <returns>The engine, or nullptr if it could not be initialized.</returns>
+std::unique_ptr<tesseract::TessBaseAPI> create_text_engine(TextProfile const& profile)
+{
+	std::unique_ptr<tesseract::TessBaseAPI> ocr = std::make_unique<tesseract::TessBaseAPI>();
+
+	if (ocr->Init(get_text_model_path(profile).c_str(), "eng", tesseract::OEM_LSTM_ONLY)) {
+		std::cerr << "Could not initialize tesseract.\n";
+		return nullptr;
+	}
+
+	ocr->SetPageSegMode(profile.mode);
+
+	ocr->SetVariable("user_defined_dpi", std::to_string(profile.dpi).c_str());
+
+	if (!profile.whitelist.empty())
+	{
+		ocr->SetVariable("tessedit_char_whitelist", profile.whitelist.c_str());
+	}
+
+	return ocr;
+}
+
+/// <summary>
+/// Keeps initialized OCR engines around between commands, so the models are only loaded once per profile.
+/// </summary>
+class TextEnginePool
+{
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	std::unordered_map<CHISL_STRING, std::vector<std::unique_ptr<tesseract::TessBaseAPI>>> m_engines;
+	// the number of engines for each profile that are being loaded in the background
+	std::unordered_map<CHISL_STRING, size_t> m_loading;
+	// the most idle engines kept for each profile, once one has been set
+	std::unordered_map<CHISL_STRING, size_t> m_limits;
+
+	/// <summary>
+	/// Loads one engine for the profile and adds it to the pool.
+	/// </summary>
+	/// <param name="name"></param>
+	/// <param name="profile"></param>
+	void load(CHISL_STRING const& name, TextProfile const& profile)
+	{
+		std::unique_ptr<tesseract::TessBaseAPI> ocr = create_text_engine(profile);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (ocr)
+			{
+				m_engines[name].push_back(std::move(ocr));
+			}
+			m_loading[name]--;
+		}
+
+		m_changed.notify_all();
+	}
+
+public:
+	/// <summary>
+	/// Takes an idle engine for the profile out of the pool, or creates one if there are none.
+	/// If engines for the profile are being loaded, waits for one of them instead.
+	/// </summary>
+	/// <param name="name"></param>
+	/// <param name="profile"></param>
+	/// <returns>The engine, or nullptr if it could not be initialized.</returns>
+	std::unique_ptr<tesseract::TessBaseAPI> acquire(CHISL_STRING const& name, TextProfile const& profile)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			std::vector<std::unique_ptr<tesseract::TessBaseAPI>>& idle = m_engines[name];
+			m_changed.wait(lock, [&]() { return !idle.empty() || m_loading[name] == 0; });
+
+			if (!idle.empty())
+			{
+				std::unique_ptr<tesseract::TessBaseAPI> ocr = std::move(idle.back());
+				idle.pop_back();
+				return ocr;
+			}
+		}
+
+		// initialize outside of the lock, since it takes a while
+		return create_text_engine(profile);
+	}
+
+	/// <summary>
+	/// Starts loading engines for the profile in the background, until the pool has at least the given number of them.
+	/// </summary>
+	/// <param name="name"></param>
+	/// <param name="profile"></param>
+	/// <param name="count"></param>
+	/// <returns>The loads that were started.</returns>
+	std::vector<std::future<void>> warm_async(CHISL_STRING const& name, TextProfile const& profile, size_t const count)
+	{
+		size_t missing;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			size_t loaded = m_engines[name].size() + m_loading[name];
+			missing = count > loaded ? count - loaded : 0;
+
+			// counted now, so acquire waits for them instead of loading its own
+			m_loading[name] += missing;
+		}
+
+		std::vector<std::future<void>> loading;
+		for (size_t i = 0; i < missing; i++)
+		{
+			loading.push_back(std::async(std::launch::async, [this, name, profile]() { load(name, profile); }));
+		}
+
+		return loading;
+	}
+
+	/// <summary>
+	/// Loads engines for the profile, all at once, until the pool has at least the given number of them.
+	/// </summary>
+	/// <param name="name"></param>
+	/// <param name="profile"></param>
+	/// <param name="count"></param>
+	void warm(CHISL_STRING const& name, TextProfile const& profile, size_t const count)
+	{
+		for (std::future<void>& future : warm_async(name, profile, count))
+		{
+			future.wait();
+		}
+	}
+
+	/// <summary>
+	/// Frees the idle engines for the profile past the given number, and keeps no more than that from then on.
+	/// Each engine holds its own copy of the model, so this is what gives the memory back.
+	/// </summary>
+	/// <param name="name"></param>
+	/// <param name="count"></param>
+	void trim(CHISL_STRING const& name, size_t const count)
+	{
+		std::vector<std::unique_ptr<tesseract::TessBaseAPI>> freed;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_limits[name] = count;
+
+			std::vector<std::unique_ptr<tesseract::TessBaseAPI>>& idle = m_engines[name];
+			while (idle.size() > count)
+			{
+				freed.push_back(std::move(idle.back()));
+				idle.pop_back();
+			}
+		}
+
+		// the engines are ended here, outside of the lock, since it takes a while
+	}
+
+	/// <summary>
+	/// Puts the engine back into the pool, ready for the next command, unless the pool already holds as many as it keeps.
+	/// </summary>
+	/// <param name="name"></param>
+	/// <param name="ocr"></param>
+	void release(CHISL_STRING const& name, std::unique_ptr<tesseract::TessBaseAPI> ocr)
+	{
+		// free the last image and its results, but keep the model loaded
+		ocr->Clear();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			auto limit = m_limits.find(name);
+			if (limit == m_limits.end() || m_engines[name].size() < limit->second)
+			{
+				m_engines[name].push_back(std::move(ocr));
+			}
+		}
+
+		m_changed.notify_all();
+	}
+
+	static TextEnginePool& get_instance()
+	{
+		static TextEnginePool pool;
+		return pool;
+	}
+};
+
+/// <summary>
+/// Borrows an OCR engine from the pool for as long as it exists.
+/// </summary>
+class TextEngine
+{
+private:
+	CHISL_STRING m_name;
+	std::unique_ptr<tesseract::TessBaseAPI> m_ocr;
+
+public:
+	TextEngine(CHISL_STRING const& name, TextProfile const& profile)
+		: m_name(name), m_ocr(TextEnginePool::get_instance().acquire(name, profile)) {}
+	TextEngine(TextEngine const&) = delete;
+	TextEngine& operator=(TextEngine const&) = delete;
+	~TextEngine()
+	{
+		if (m_ocr)
+		{
+			TextEnginePool::get_instance().release(m_name, std::move(m_ocr));
+		}
+	}
+
+	bool valid() const { return static_cast<bool>(m_ocr); }
+	tesseract::TessBaseAPI& get() { return *m_ocr; }
+};
+
+/// <summary>
+/// Runs the OCR engine over the image, or only over the regions of it that probably contain text.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="options"></param>
+/// <param name="callback">Called with the engine after it has been given each region, along with the region and its scale from the engine back to the image.</param>
+/// <returns>False if the engine could not be started.</returns>
+bool recognize_regions(Image const& image, ReadOptions const& options, std::function<void(tesseract::TessBaseAPI&, cv::Rect const&, CHISL_NUMBER, CHISL_NUMBER)> const& callback)
+{
+	std::optional<TextProfile> profile = get_text_profile(options.profile);
+	if (!profile.has_value())
+	{
+		std::cerr << "Unknown text profile \"" << options.profile << "\".\n";
+		return false;
+	}
+
+	TextEngine engine(string_to_lower(options.profile), profile.value());
+	if (!engine.valid())
+	{
+		return false;
+	}
+
+	tesseract::TessBaseAPI& ocr = engine.get();
+
+	cv::Rect const bounds(0, 0, image.get_width(), image.get_height());
+	std::vector<cv::Rect> regions;
+
+	// the grayscale image is kept on the image for next time, and is only made when the regions are found or read from it,
+	// since the fused pass converts just the regions it reads
+	CHISL_MATRIX const gray = options.regions || !options.fused ? image.get_view(ColorMode::Gray) : CHISL_MATRIX();
+	CHISL_MATRIX const& source = options.fused ? image.get() : gray;
+
+	if (options.regions)
+	{
+		regions = find_text_regions(gray);
+
+		int area = 0;
+		for (cv::Rect const& region : regions)
+		{
+			area += region.area();
+		}
+
+		// when text is everywhere, one pass over the whole image is cheaper,
+		// and when none was found, it may be too faint to find, so the whole image is still read
+		if (regions.empty() || area > bounds.area() * TEXT_REGION_MAX_COVERAGE)
+		{
+			regions = { bounds };
+		}
+	}
+	else
+	{
+		regions = { bounds };
+	}
+
+	for (cv::Rect const& region : regions)
+	{
+		Image srcImage = adjust_image_for_reading(Image(source(region)), options);
+		CHISL_MATRIX src = srcImage.get();
+
+		// process text from image
+		ocr.SetImage(src.data, src.cols, src.rows, 1, static_cast<int>(src.step));
+
+		CHISL_NUMBER scaleX = static_cast<CHISL_NUMBER>(region.width) / src.cols;
+		CHISL_NUMBER scaleY = static_cast<CHISL_NUMBER>(region.height) / src.rows;
+
+		callback(ocr, region, scaleX, scaleY);
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Finds all of the text within the image at the level, and where each piece of text is.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="level"></param>
+/// <param name="threshold">The minimum confidence, from 0 to 1.</param>
+/// <param name="options"></param>
+/// <returns>The text, and the Matches of where they are within the image.</returns>
+std::optional<std::vector<std::pair<CHISL_STRING, Match>>> recognize_text(Image const& image, tesseract::PageIteratorLevel const level, CHISL_NUMBER const threshold, ReadOptions const& options)
+{
+	// learned glyph sets are read without the OCR engine
+	std::shared_ptr<GlyphSet const> glyphSet = GlyphSetLibrary::get_instance().get(options.profile);
+	if (glyphSet)
+	{
+		return read_glyphs(image, *glyphSet, level, std::max(threshold, GLYPH_THRESHOLD));
+	}
+
+	std::vector<std::pair<CHISL_STRING, Match>> results;
+
+	bool success = recognize_regions(image, options, [&](tesseract::TessBaseAPI& ocr, cv::Rect const& region, CHISL_NUMBER const scaleX, CHISL_NUMBER const scaleY) {
+		// get bounding boxes for text
+		ocr.Recognize(nullptr);
+		tesseract::ResultIterator* ri = ocr.GetIterator();
+
+		if (ri == 0)
+		{
+			return;
+		}
+
+		do {
+			const char* word = ri->GetUTF8Text(level);
+			float conf = ri->Confidence(level);
+			if (word != 0 && conf > 100.0 * threshold) {
+				int x1, y1, x2, y2;
+				ri->BoundingBox(level, &x1, &y1, &x2, &y2);
+				CHISL_POINT point(region.x + static_cast<int>(x1 * scaleX), region.y + static_cast<int>(y1 * scaleY));
+				CHISL_POINT size(static_cast<int>((x2 - x1) * scaleX), static_cast<int>((y2 - y1) * scaleY));
+				results.emplace_back(CHISL_STRING(word), Match(size, point));
+			}
+			delete[] word;
+		} while (ri->Next(level));
+
+		delete ri;
+		});
+
+	if (!success)
+	{
+		return std::nullopt;
+	}
+
+	return results;
+}
+
+/// <summary>
+/// Finds text within an image.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="text"></param>
+/// <param name="level"></param>
+/// <param name="threshold"></param>
+/// <param name="options"></param>
+/// <returns></returns>
+std::optional<Match> find_text(Image const& image, CHISL_STRING const& text, tesseract::PageIteratorLevel const level, CHISL_NUMBER const threshold, ReadOptions const& options)
+{
+	std::optional<std::vector<std::pair<CHISL_STRING, Match>>> results = recognize_text(image, level, threshold, options);
+
+	if (!results.has_value())
+	{
+		return std::nullopt;
+	}
+
+	CHISL_STRING searchText = string_to_lower(text);
+
+	for (auto const& [word, match] : results.value())
+	{
+		if (string_to_lower(string_trim(word)) == searchText)
+		{
+			return match;
+		}
+	}
+
+	return std::nullopt;
+}
+
+/// <summary>
+/// Keeps only the best of each group of overlapping spots, so each occurance is matched once.
+/// </summary>
+/// <param name="spots">The top left of each spot that passed the threshold, best first.</param>
+/// <param name="size">The size of the template.</param>
+/// <param name="overlap">The most a worse spot may overlap a kept one, as their intersection over their union.</param>
+/// <param name="distance">The least distance between the centers of two kept spots.</param>
+/// <returns>The kept spots, best first.</returns>
+std::vector<CHISL_POINT> suppress_matches(std::vector<CHISL_POINT> const& spots, CHISL_POINT const size, CHISL_NUMBER const overlap, CHISL_NUMBER const distance)
+{
+	CHISL_NUMBER const area = static_cast<CHISL_NUMBER>(size.x) * size.y;
+	CHISL_NUMBER const distanceSquared = distance * distance;
+
+	std::vector<CHISL_POINT> kept;
+
+	for (CHISL_POINT const& spot : spots)
+	{
+		bool suppressed = false;
+
+		for (CHISL_POINT const& other : kept)
+		{
+			int dx = std::abs(spot.x - other.x);
+			int dy = std::abs(spot.y - other.y);
+
+			// both are the same size, so the intersection only depends on how far apart they are
+			CHISL_NUMBER intersection = static_cast<CHISL_NUMBER>(std::max(size.x - dx, 0)) * std::max(size.y - dy, 0);
+			if (intersection > overlap * (area * 2.0 - intersection) || static_cast<CHISL_NUMBER>(dx * dx + dy * dy) < distanceSquared)
+			{
+				suppressed = true;
+				break;
+			}
+		}
+
+		if (!suppressed)
+		{
+			kept.push_back(spot);
+		}
+	}
+
+	return kept;
 }
 
 /// <summary>
-/// Finds a template image within an image.
+/// Finds all occurances of the template image within the image, in reading order.
 /// </summary>
 /// <param name="image"></param>
 /// <param name="templateImage"></param>
 /// <param name="threshold"></param>
+/// <param name="options"></param>
 /// <returns></returns>
-std::optional<Match> find(Image const& image, Image& templateImage, CHISL_NUMBER const threshold)
+std::optional<MatchCollection> find_all(Image const& image, Image& templateImage, CHISL_NUMBER const threshold, FindOptions const& options)
 {
 	try {
-		CHISL_MATRIX result;
-		cv::matchTemplate(image.get(), templateImage.get(), result, cv::TM_CCOEFF_NORMED);
+		if (options.method == FindMethod::Features)
+		{
+			// the keypoints only agree on one spot
+			std::optional<std::pair<Match, CHISL_NUMBER>> best = match_features(image, templateImage, threshold, options.color);
+			if (!best.has_value())
+			{
+				return MatchCollection();
+			}
 
-		CHISL_NUMBER minVal, maxVal;
-		CHISL_POINT minLoc, maxLoc;
-		cv::minMaxLoc(result, &minVal, &maxVal, &minLoc, &maxLoc);
+			return MatchCollection(std::vector<Match>{ best.value().first });
+		}
+
+		Image scaledTemplate = templateImage;
 
-		if (result.at<float>(maxLoc.y, maxLoc.x) < threshold)
+		if (options.scaleMin != 1.0 || options.scaleMax != 1.0)
 		{
-			return std::nullopt;
+			// every occurance on the same display is the same size, so use the scale of the best one
+			std::optional<std::pair<Match, CHISL_NUMBER>> best = find_best_scaled(image, templateImage, threshold, options);
+			if (!best.has_value())
+			{
+				return MatchCollection();
+			}
+
+			scaledTemplate = templateImage.get_scaled(templateImage.get_found_scale(image.get_whole_size()).value());
+		}
+
+		CHISL_MATRIX src = image.get_view(options.color);
+		CHISL_MATRIX templ = scaledTemplate.get_view(options.color);
+
+		std::vector<CHISL_POINT> spots;
+
+		if (options.method == FindMethod::Exact || threshold >= 1.0)
+		{
+			spots = match_exact(src, templ, true);
+		}
+		else if (options.method == FindMethod::Absolute || options.method == FindMethod::Squared)
+		{
+			std::vector<std::pair<CHISL_POINT, CHISL_NUMBER>> scored = match_difference(image, scaledTemplate, options.color, options.method == FindMethod::Squared, threshold, true);
+
+			std::sort(scored.begin(), scored.end(), [](auto const& a, auto const& b)
+				{
+					return a.second > b.second;
+				});
+
+			spots.reserve(scored.size());
+			for (auto const& [point, score] : scored)
+			{
+				spots.push_back(point);
+			}
+		}
+		else
+		{
+			CHISL_MATRIX result = match_template(src, templ, options.prefilter > 0.0 ? get_prefilter_mask(image, scaledTemplate, options.color, options.prefilter) : CHISL_MATRIX());
+
+			// pick out every spot at or above the threshold that is also the best of its neighbours,
+			// since the spots around a match score almost as well and would all be sorted only to be suppressed
+			CHISL_MATRIX peaks;
+			cv::dilate(result, peaks, CHISL_MATRIX());
+
+			CHISL_MATRIX mask = (result >= peaks) & (result >= threshold);
+
+			cv::findNonZero(mask, spots);
+
+			std::sort(spots.begin(), spots.end(), [&result](CHISL_POINT const& a, CHISL_POINT const& b)
+				{
+					return result.at<float>(a) > result.at<float>(b);
+				});
 		}
 
-		return Match(templateImage.get_size(), maxLoc);
+		std::vector<CHISL_POINT> points = suppress_matches(spots, scaledTemplate.get_size(), options.overlap, options.distance);
+
+		// the spots are ranked best first so the best of each cluster is kept, but scripts expect reading order
+		std::sort(points.begin(), points.end(), [](CHISL_POINT const& a, CHISL_POINT const& b)
+			{
+				return a.y != b.y ? a.y < b.y : a.x < b.x;
+			});
+
+		return MatchCollection(scaledTemplate.get_size(), points);
 	}
 	catch (const cv::Exception& ex) {
 		std::cerr << "OpenCV exception: " << ex.what() << std::endl;
@@ -1384,107 +5008,148 @@ std::optional<Match> find(Image const& image, Image& templateImage, CHISL_NUMBER
 }
 
 /// <summary>
-/// Finds text within an image.
+/// Finds a template image within a region of an image, without copying the region.
 /// </summary>
 /// <param name="image"></param>
-/// <param name="text"></param>
-/// <param name="level"></param>
+/// <param name="region"></param>
+/// <param name="templateImage"></param>
 /// <param name="threshold"></param>
-/// <returns></returns>
-std::optional<Match> find_text(Image const& image, CHISL_STRING const& text, tesseract::PageIteratorLevel const level, CHISL_NUMBER const threshold)
+/// <param name="options"></param>
+/// <returns>The match, relative to the whole image, or nothing if it was not found or the template cannot fit within the region.</returns>
+std::optional<Match> find_within(Image const& image, cv::Rect const& region, Image& templateImage, CHISL_NUMBER const threshold, FindOptions const& options)
 {
-	Image srcImage = adjust_image_for_reading(image);
-	CHISL_MATRIX src = srcImage.get();
+	cv::Rect area = region & cv::Rect(0, 0, image.get_width(), image.get_height());
 
-	tesseract::TessBaseAPI ocr;
-	if (ocr.Init(get_path().append("/tessdata").c_str(), "eng", tesseract::OEM_LSTM_ONLY)) {
-		std::cerr << "Could not initialize tesseract.\n";
+	// the template may still fit at a smaller scale
+	CHISL_NUMBER const smallest = std::min({ options.scaleMin, options.scaleMax, 1.0 });
+	if (area.width < templateImage.get_width() * smallest || area.height < templateImage.get_height() * smallest)
+	{
 		return std::nullopt;
 	}
 
-	ocr.SetPageSegMode(tesseract::PSM_SPARSE_TEXT);
+	// the last matches are kept relative to whole images
+	FindOptions regionOptions = options;
+	regionOptions.nearby = 0;
 
-	ocr.SetVariable("user_defined_dpi", "71");
-
-	// process text from image
-	ocr.SetImage(src.data, src.cols, src.rows, 1, static_cast<int>(src.step));
+	std::optional<Match> found = find(image.region(area), templateImage, threshold, regionOptions);
+	if (!found.has_value())
+	{
+		return std::nullopt;
+	}
 
-	// get bounding boxes for text
-	ocr.Recognize(nullptr);
-	tesseract::ResultIterator* ri = ocr.GetIterator();
+	return Match(found.value().get_size(), found.value().get_point() + area.tl());
+}
 
-	CHISL_NUMBER targetX = -1, targetY = -1, targetWidth = -1, targetHeight = -1;
+/// <summary>
+/// Finds all occurances of the template image within a region of an image, without copying the region.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="region"></param>
+/// <param name="templateImage"></param>
+/// <param name="threshold"></param>
+/// <param name="options"></param>
+/// <returns>The matches, relative to the whole image, or nothing if the template cannot fit within the region.</returns>
+std::optional<MatchCollection> find_all_within(Image const& image, cv::Rect const& region, Image& templateImage, CHISL_NUMBER const threshold, FindOptions const& options)
+{
+	cv::Rect area = region & cv::Rect(0, 0, image.get_width(), image.get_height());
 
-	CHISL_NUMBER scaleX = static_cast<CHISL_NUMBER>(image.get_width()) / src.cols;
-	CHISL_NUMBER scaleY = static_cast<CHISL_NUMBER>(image.get_height()) / src.rows;
+	// the template may still fit at a smaller scale
+	CHISL_NUMBER const smallest = std::min({ options.scaleMin, options.scaleMax, 1.0 });
+	if (area.width < templateImage.get_width() * smallest || area.height < templateImage.get_height() * smallest)
+	{
+		return std::nullopt;
+	}
 
-	CHISL_STRING searchText = string_to_lower(text);
+	std::optional<MatchCollection> found = find_all(image.region(area), templateImage, threshold, options);
+	if (!found.has_value())
+	{
+		return std::nullopt;
+	}
 
-	if (ri != 0) {
-		do {
-			const char* word = ri->GetUTF8Text(level);
-			float conf = ri->Confidence(level);
-			if (word != 0 && conf > 100.0 * threshold) {
-				int x1, y1, x2, y2;
-				ri->BoundingBox(level, &x1, &y1, &x2, &y2);
-				CHISL_STRING extractedWord(word);
-				extractedWord = string_trim(extractedWord);
-				extractedWord = string_to_lower(extractedWord);
-				//std::cout << "Found: " << extractedWord << std::endl;
-				if (extractedWord == searchText) {
-					//std::cout << "Match!" << std::endl;
-					targetX = x1 * scaleX;
-					targetY = y1 * scaleY;
-					targetWidth = (x2 - x1) * scaleX;
-					targetHeight = (y2 - y1) * scaleY;
-					break;
-				}
-			}
-			delete[] word;
-		} while (ri->Next(level));
+	std::vector<Match> matches;
+	matches.reserve(found.value().count());
+	for (size_t i = 0; i < found.value().count(); i++)
+	{
+		Match match = found.value().get(i);
+		matches.push_back(Match(match.get_size(), match.get_point() + area.tl()));
 	}
 
-	ocr.End();
+	return MatchCollection(matches);
+}
 
-	if (targetX != -1 && targetY != -1)
-	{
-		return Match(CHISL_POINT(static_cast<int>(targetWidth), static_cast<int>(targetHeight)), CHISL_POINT(static_cast<int>(targetX), static_cast<int>(targetY)));
+/// <summary>
+/// Finds the first pixel of the color within a region of the image, in reading order.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="region"></param>
+/// <param name="red"></param>
+/// <param name="green"></param>
+/// <param name="blue"></param>
+/// <param name="tolerance">How far each channel can be from the color.</param>
+/// <returns>The pixel, relative to the whole image.</returns>
+std::optional<Match> find_color(Image const& image, cv::Rect const& region, CHISL_INT const red, CHISL_INT const green, CHISL_INT const blue, CHISL_INT const tolerance)
+{
+	try {
+		cv::Rect area = region & cv::Rect(0, 0, image.get_width(), image.get_height());
+		if (area.empty())
+		{
+			return std::nullopt;
+		}
+
+		std::vector<CHISL_POINT> points = match_color(image.get()(area), cv::saturate_cast<uchar>(blue), cv::saturate_cast<uchar>(green), cv::saturate_cast<uchar>(red), cv::saturate_cast<uchar>(tolerance), 1);
+		if (points.empty())
+		{
+			return std::nullopt;
+		}
+
+		return Match(CHISL_POINT(1, 1), points.front() + area.tl());
 	}
-	else
-	{
+	catch (const cv::Exception& ex) {
+		std::cerr << "OpenCV exception: " << ex.what() << std::endl;
+		return std::nullopt;
+	}
+	catch (const std::exception& ex) {
+		std::cerr << "Standard exception: " << ex.what() << std::endl;
+		return std::nullopt;
+	}
+	catch (...) {
+		std::cerr << "Unknown exception occurred." << std::endl;
 		return std::nullopt;
 	}
 }
 
 /// <summary>
-/// Finds all occurances of the template image within the image.
+/// Finds every pixel of the color within a region of the image, in reading order.
+/// Each pixel is its own match, so no more than FIND_COLOR_MAX_MATCHES are kept.
 /// </summary>
 /// <param name="image"></param>
-/// <param name="templateImage"></param>
-/// <param name="threshold"></param>
-/// <returns></returns>
-std::optional<MatchCollection> find_all(Image const& image, Image& templateImage, CHISL_NUMBER const threshold)
+/// <param name="region"></param>
+/// <param name="red"></param>
+/// <param name="green"></param>
+/// <param name="blue"></param>
+/// <param name="tolerance">How far each channel can be from the color.</param>
+/// <returns>The pixels, relative to the whole image.</returns>
+std::optional<MatchCollection> find_all_color(Image const& image, cv::Rect const& region, CHISL_INT const red, CHISL_INT const green, CHISL_INT const blue, CHISL_INT const tolerance)
 {
 	try {
-		CHISL_MATRIX result;
-		cv::matchTemplate(image.get(), templateImage.get(), result, cv::TM_CCOEFF_NORMED);
-
-		std::vector<CHISL_POINT> points;
+		cv::Rect area = region & cv::Rect(0, 0, image.get_width(), image.get_height());
+		if (area.empty())
+		{
+			return MatchCollection();
+		}
 
-		int w = templateImage.get_width();
-		int h = templateImage.get_height();
+		std::vector<CHISL_POINT> points = match_color(image.get()(area), cv::saturate_cast<uchar>(blue), cv::saturate_cast<uchar>(green), cv::saturate_cast<uchar>(red), cv::saturate_cast<uchar>(tolerance), FIND_COLOR_MAX_MATCHES);
+		if (points.size() >= FIND_COLOR_MAX_MATCHES)
+		{
+			std::cerr << "Found more than " << FIND_COLOR_MAX_MATCHES << " pixels of the color. Only the first " << FIND_COLOR_MAX_MATCHES << " are kept.\n";
+		}
 
-		for (int y = 0; y < result.rows; ++y) {
-			for (int x = 0; x < result.cols; ++x) {
-				CHISL_NUMBER value = result.at<float>(y, x);
-				if (value >= threshold) {
-					CHISL_POINT point(x, y);
-					points.push_back(point);
-				}
-			}
+		for (CHISL_POINT& point : points)
+		{
+			point += area.tl();
 		}
 
-		return MatchCollection(templateImage.get_size(), points);
+		return MatchCollection(CHISL_POINT(1, 1), points);
 	}
 	catch (const cv::Exception& ex) {
 		std::cerr << "OpenCV exception: " << ex.what() << std::endl;
@@ -1507,59 +5172,28 @@ std::optional<MatchCollection> find_all(Image const& image, Image& templateImage
 /// <param name="text"></param>
 /// <param name="level"></param>
 /// <param name="threshold"></param>
+/// <param name="options"></param>
 /// <returns></returns>
-std::optional<MatchCollection> find_all_text(Image const& image, CHISL_STRING const& text, tesseract::PageIteratorLevel const level, CHISL_NUMBER const threshold)
+std::optional<MatchCollection> find_all_text(Image const& image, CHISL_STRING const& text, tesseract::PageIteratorLevel const level, CHISL_NUMBER const threshold, ReadOptions const& options)
 {
-	Image srcImage = adjust_image_for_reading(image);
-	CHISL_MATRIX src = srcImage.get();
+	std::optional<std::vector<std::pair<CHISL_STRING, Match>>> results = recognize_text(image, level, threshold, options);
 
-	tesseract::TessBaseAPI ocr;
-	if (ocr.Init(get_path().append("/tessdata").c_str(), "eng", tesseract::OEM_LSTM_ONLY)) {
-		std::cerr << "Could not initialize tesseract.\n";
+	if (!results.has_value())
+	{
 		return std::nullopt;
 	}
 
-	ocr.SetPageSegMode(tesseract::PSM_SPARSE_TEXT);
-
-	ocr.SetVariable("user_defined_dpi", "71");
-
-	// process text from image
-	ocr.SetImage(src.data, src.cols, src.rows, 1, static_cast<int>(src.step));
-
-	// get bounding boxes for text
-	ocr.Recognize(nullptr);
-	tesseract::ResultIterator* ri = ocr.GetIterator();
-
 	std::vector<Match> matches;
 
-	CHISL_NUMBER targetX = -1, targetY = -1, targetWidth = -1, targetHeight = -1;
-
-	CHISL_NUMBER scaleX = static_cast<CHISL_NUMBER>(image.get_width()) / src.cols;
-	CHISL_NUMBER scaleY = static_cast<CHISL_NUMBER>(image.get_height()) / src.rows;
-
-	if (ri != 0) {
-		do {
-			const char* word = ri->GetUTF8Text(level);
-			float conf = ri->Confidence(level);
-			if (word != 0 && conf > 100.0 * threshold) {
-				int x1, y1, x2, y2;
-				ri->BoundingBox(level, &x1, &y1, &x2, &y2);
-				CHISL_STRING extractedWord(word);
-				if (extractedWord == text) {
-					targetX = x1 * scaleX;
-					targetY = y1 * scaleY;
-					targetWidth = (x2 - x1) * scaleX;
-					targetHeight = (y2 - y1) * scaleY;
-					matches.push_back(Match(CHISL_POINT(static_cast<int>(targetWidth), static_cast<int>(targetHeight)), CHISL_POINT(static_cast<int>(targetX), static_cast<int>(targetY))));
-					break;
-				}
-			}
-			delete[] word;
-		} while (ri->Next(level));
+	// unlike find_text, the text must match exactly, as it always has
+	for (auto const& [word, match] : results.value())
+	{
+		if (word == text)
+		{
+			matches.push_back(match);
+		}
 	}
 
-	ocr.End();
-
 	if (!matches.empty())
 	{
 		return MatchCollection(matches);
@@ -1574,31 +5208,140 @@ std::optional<MatchCollection> find_all_text(Image const& image, CHISL_STRING co
 /// Reads all of the text within the given image.
 /// </summary>
 /// <param name="image"></param>
+/// <param name="options"></param>
 /// <returns></returns>
-CHISL_STRING read_from_image(Image const& image)
+CHISL_STRING read_from_image(Image const& image, ReadOptions const& options)
 {
-	Image srcImage = adjust_image_for_reading(image);
-	CHISL_MATRIX src = srcImage.get();
+	CHISL_STRING outString;
 
-	tesseract::TessBaseAPI ocr;
-	if (ocr.Init(get_path().append("/tessdata").c_str(), "eng", tesseract::OEM_LSTM_ONLY)) {
-		std::cerr << "Could not initialize tesseract.\n";
-		return "";
+	std::shared_ptr<GlyphSet const> glyphSet = GlyphSetLibrary::get_instance().get(options.profile);
+	if (glyphSet)
+	{
+		for (auto const& [line, match] : read_glyphs(image, *glyphSet, tesseract::RIL_TEXTLINE, GLYPH_THRESHOLD))
+		{
+			outString += line + "\n";
+		}
+
+		return outString;
 	}
 
-	ocr.SetPageSegMode(tesseract::PSM_SPARSE_TEXT);
+	recognize_regions(image, options, [&](tesseract::TessBaseAPI& ocr, cv::Rect const& region, CHISL_NUMBER const scaleX, CHISL_NUMBER const scaleY) {
+		char* outText = ocr.GetUTF8Text();
+		if (outText)
+		{
+			outString += outText;
+		}
+		delete[] outText;
+		});
+
+	return outString;
+}
+
+/// <summary>
+/// Reads the text within each of the given matches in the image.
+/// The matches are shared between the configured number of engines, which read them in parallel.
+/// </summary>
+/// <param name="image"></param>
+/// <param name="matches"></param>
+/// <param name="options"></param>
+/// <returns>The text from each match, in the same order, or nothing if no engine could be started.</returns>
+std::optional<TextCollection> read_all_from_image(Image const& image, MatchCollection const& matches, ReadOptions const& options)
+{
+	size_t count = matches.count();
+	std::vector<CHISL_STRING> texts(count);
 
-	ocr.SetVariable("user_defined_dpi", "71");
+	cv::Rect const bounds(0, 0, image.get_width(), image.get_height());
 
-	// process text from image
-	ocr.SetImage(src.data, src.cols, src.rows, 1, static_cast<int>(src.step));
-	char* outText = ocr.GetUTF8Text();
-	CHISL_STRING outString = outText;
-	delete[] outText;
+	std::shared_ptr<GlyphSet const> glyphSet = GlyphSetLibrary::get_instance().get(options.profile);
 
-	ocr.End();
+	// converted once, then each match reads its own part of it, unless the fused pass converts each part as it reads it
+	CHISL_MATRIX const source = options.fused && !glyphSet ? image.get() : image.get_view(ColorMode::Gray);
 
-	return outString;
+	if (glyphSet)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			Match match = matches.get(i);
+			cv::Rect region = cv::Rect(match.get_point(), cv::Size(match.get_size())) & bounds;
+			if (region.empty())
+			{
+				continue;
+			}
+
+			for (auto const& [line, lineMatch] : read_glyphs(Image(source(region)), *glyphSet, tesseract::RIL_TEXTLINE, GLYPH_THRESHOLD))
+			{
+				texts[i] += texts[i].empty() ? line : "\n" + line;
+			}
+		}
+
+		return TextCollection(texts);
+	}
+
+	std::optional<TextProfile> profile = get_text_profile(options.profile);
+	if (!profile.has_value())
+	{
+		std::cerr << "Unknown text profile \"" << options.profile << "\".\n";
+		return std::nullopt;
+	}
+
+	CHISL_STRING name = string_to_lower(options.profile);
+
+	// each worker takes the next match that has not been read yet
+	std::atomic<size_t> next = 0;
+	auto work = [&]() {
+		TextEngine engine(name, profile.value());
+		if (!engine.valid())
+		{
+			return false;
+		}
+
+		tesseract::TessBaseAPI& ocr = engine.get();
+
+		for (size_t i = next++; i < count; i = next++)
+		{
+			Match match = matches.get(i);
+			cv::Rect region = cv::Rect(match.get_point(), cv::Size(match.get_size())) & bounds;
+			if (region.empty())
+			{
+				continue;
+			}
+
+			Image srcImage = adjust_image_for_reading(Image(source(region)), options);
+			CHISL_MATRIX src = srcImage.get();
+			ocr.SetImage(src.data, src.cols, src.rows, 1, static_cast<int>(src.step));
+
+			char* outText = ocr.GetUTF8Text();
+			if (outText)
+			{
+				texts[i] = string_trim(outText);
+			}
+			delete[] outText;
+		}
+
+		return true;
+		};
+
+	size_t workerCount = std::clamp(static_cast<size_t>(options.engines), static_cast<size_t>(1), std::max(count, static_cast<size_t>(1)));
+
+	// this thread reads too, alongside the others
+	std::vector<std::future<bool>> workers;
+	for (size_t i = 1; i < workerCount; i++)
+	{
+		workers.push_back(std::async(std::launch::async, work));
+	}
+
+	bool success = work();
+	for (std::future<bool>& worker : workers)
+	{
+		success = worker.get() || success;
+	}
+
+	if (!success)
+	{
+		return std::nullopt;
+	}
+
+	return TextCollection(texts);
 }
 
 /// <summary>
@@ -1611,6 +5354,7 @@ CHISL_STRING read_from_image(Image const& image)
 void draw(Image& image, Match const& match, cv::Scalar const color = cv::Scalar(0, 0, 255), int width = 2)
 {
 	cv::rectangle(image.get(), match.get_point(), match.get_point() + match.get_size(), color, width);
+	image.invalidate();
 }
 
 /// <summary>
@@ -1623,6 +5367,7 @@ void draw(Image& image, Match const& match, cv::Scalar const color = cv::Scalar(
 void draw_rect(Image& image, int const x, int const y, int const w, int const h, cv::Scalar const color = cv::Scalar(0, 0, 255), int width = 2)
 {
 	cv::rectangle(image.get(), CHISL_POINT(x, y), CHISL_POINT(x + w, y + h), color, width);
+	image.invalidate();
 }
 
 enum class MouseButton
@@ -2169,7 +5914,10 @@ void record(CHISL_STRING const& path)
 std::vector<Token> tokenize(CHISL_STRING const& str)
 {
 	// split into string tokens
-	CHISL_REGEX re(RAW_INPUT_PATTERN_STRING "|[+-]?\\d?\\.?\\d+|\\b[\\w.:\\\\]+\\b( (key|mouse|all text|all|text))?|[<>]=?|[!=]=|[\\.\\+\\-\\*\\/#\\(\\)]|\\n");
+	// "color", "any" and "each" are only part of the keyword when a variable and "by" or "at" follow,
+	// so "Find color by icon in screen." still finds a variable named color
+	// keywords match in any case, the same as the commands
+	CHISL_REGEX re(RAW_INPUT_PATTERN_STRING "|[+-]?\\d?\\.?\\d+|\\b(find( all)? color|find (any|each))(?= " RAW_INPUT_PATTERN_VARIABLE " by )|\\bget color(?= " RAW_INPUT_PATTERN_VARIABLE "( " RAW_INPUT_PATTERN_VARIABLE " " RAW_INPUT_PATTERN_VARIABLE ")? at )|\\b[\\w.:\\\\]+\\b( (key|mouse|all text|all|text))?|[<>]=?|[!=]=|[\\.\\+\\-\\*\\/#\\(\\)]|\\n", std::regex_constants::icase);
 	std::vector<CHISL_STRING> strTokens = string_split(str, re);
 
 	// parse into tokens
@@ -2225,21 +5973,32 @@ private:
 	CHISL_REGEX m_regex;
 	std::unordered_map<CHISL_STRING, Parameter> m_parameters;
 	std::function<int(Command const&, Program&)> m_action;
+	// words that are only fillers within the commands that use them, so they can still be variable names elsewhere
+	std::vector<CHISL_STRING> m_fillers;
 
 public:
 	CommandTemplate(ChislToken const token, CHISL_STRING const& regex, std::vector<Parameter> const& params, std::function<int(Command const&, Program&)> const& action)
-		: m_token(token), m_regex(std::regex(regex, std::regex_constants::icase)), m_parameters(), m_action(action)
+		: m_token(token), m_regex(std::regex(regex, std::regex_constants::icase)), m_parameters(), m_action(action), m_fillers()
 	{
 		m_parameters.reserve(params.size());
 		for (Parameter const& p : params)
 		{
 			m_parameters.emplace(p.name, p);
 		}
+
+		for (CHISL_STRING const filler : { "using", "within", "tolerance" })
+		{
+			if (regex.find(" " + filler + " ") != CHISL_STRING::npos)
+			{
+				m_fillers.push_back(filler);
+			}
+		}
 	}
 
 	ChislToken get_token() const { return m_token; }
 	CHISL_REGEX const& get_regex() const { return m_regex; }
 	Parameter const& get_parameter(CHISL_STRING const& name) const { return m_parameters.at(name); }
+	bool is_filler(CHISL_STRING const& word) const { return std::find(m_fillers.begin(), m_fillers.end(), string_to_lower(word)) != m_fillers.end(); }
 	int execute(Command const& command, Program& program) const { return m_action(command, program); }
 };
 
@@ -2255,15 +6014,18 @@ private:
 
 	std::vector<Token> m_args;
 
+	CHISL_STRING m_text;
+
 public:
 	Command() = default;
-	Command(CommandTemplate const& commandTemplate, CHISL_INDEX const row, std::vector<Token> const& args)
-		: m_template(&commandTemplate), m_row(row), m_args(args) { }
+	Command(CommandTemplate const& commandTemplate, CHISL_INDEX const row, std::vector<Token> const& args, CHISL_STRING const& text)
+		: m_template(&commandTemplate), m_row(row), m_args(args), m_text(text) { }
 	
 	bool valid() const { return m_template; }
 	CommandTemplate const& get_template() const { return *m_template; }
 	ChislToken get_token() const { return m_template->get_token(); }
 	CHISL_INDEX get_row() const { return m_row; }
+	CHISL_STRING const& get_text() const { return m_text; }
 	Parameter const& get_param(CHISL_STRING const& name) const { return m_template->get_parameter(name); }
 	Token const& get_arg(CHISL_STRING const& name) const
 	{
@@ -2331,48 +6093,155 @@ std::vector<Token> shunting_yard(std::vector<Token> const& tokens)
 					break;
 				}
 
-				output.push_back(other);
-				operators.pop_back();
+				output.push_back(other);
+				operators.pop_back();
+			}
+
+			operators.push_back(token);
+		}
+		else if (chislToken == CHISL_PUNCT_OPEN_GROUP)
+		{
+			operators.push_back(token);
+		}
+		else if (chislToken == CHISL_PUNCT_CLOSE_GROUP)
+		{
+			while (!operators.empty() && operators.back().get_token() != CHISL_PUNCT_OPEN_GROUP)
+			{
+				output.push_back(operators.back());
+				operators.pop_back();
+			}
+
+			if (operators.empty())
+			{
+				std::cerr << "Mismatch parenthesis." << std::endl;
+			}
+			else
+			{
+				operators.pop_back();
+			}
+		}
+	}
+
+	while (!operators.empty())
+	{
+		if (operators.back().get_token() == CHISL_PUNCT_OPEN_GROUP)
+		{
+			std::cerr << "Mismatch parenthesis." << std::endl;
+			continue;
+		}
+		output.push_back(operators.back());
+		operators.pop_back();
+	}
+
+	return output;
+}
+
+/// <summary>
+/// Runs work on a fixed set of worker threads, in the order it was given.
+/// </summary>
+class ThreadPool
+{
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	std::deque<std::function<void()>> m_queue;
+	std::vector<std::thread> m_workers;
+	size_t m_active;
+	bool m_stopping;
+
+	void work()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_changed.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+
+				if (m_queue.empty())
+				{
+					return;
+				}
+
+				task = std::move(m_queue.front());
+				m_queue.pop_front();
+				m_active++;
+			}
+
+			task();
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_active--;
 			}
 
-			operators.push_back(token);
+			m_changed.notify_all();
 		}
-		else if (chislToken == CHISL_PUNCT_OPEN_GROUP)
+	}
+
+public:
+	ThreadPool(size_t const count)
+		: m_active(0), m_stopping(false)
+	{
+		for (size_t i = 0; i < count; i++)
 		{
-			operators.push_back(token);
+			m_workers.emplace_back(&ThreadPool::work, this);
 		}
-		else if (chislToken == CHISL_PUNCT_CLOSE_GROUP)
+	}
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+	~ThreadPool()
+	{
 		{
-			while (!operators.empty() && operators.back().get_token() != CHISL_PUNCT_OPEN_GROUP)
-			{
-				output.push_back(operators.back());
-				operators.pop_back();
-			}
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
 
-			if (operators.empty())
-			{
-				std::cerr << "Mismatch parenthesis." << std::endl;
-			}
-			else
-			{
-				operators.pop_back();
-			}
+		m_changed.notify_all();
+
+		for (std::thread& worker : m_workers)
+		{
+			worker.join();
 		}
 	}
 
-	while (!operators.empty())
+	/// <summary>
+	/// Queues the work to be ran on the next free worker.
+	/// </summary>
+	/// <param name="task"></param>
+	/// <returns>The result of the work, once it is done.</returns>
+	template<typename T>
+	std::shared_future<T> submit(std::function<T()> const& task)
 	{
-		if (operators.back().get_token() == CHISL_PUNCT_OPEN_GROUP)
+		std::shared_ptr<std::packaged_task<T()>> packaged = std::make_shared<std::packaged_task<T()>>(task);
+		std::shared_future<T> future = packaged->get_future().share();
+
 		{
-			std::cerr << "Mismatch parenthesis." << std::endl;
-			continue;
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queue.push_back([packaged]() { (*packaged)(); });
 		}
-		output.push_back(operators.back());
-		operators.pop_back();
+
+		m_changed.notify_all();
+
+		return future;
 	}
 
-	return output;
-}
+	/// <summary>
+	/// Waits until all of the queued work is done.
+	/// </summary>
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_changed.wait(lock, [this]() { return m_queue.empty() && m_active == 0; });
+	}
+
+	static ThreadPool& get_instance()
+	{
+		static ThreadPool pool(std::clamp(static_cast<size_t>(std::thread::hardware_concurrency()), static_cast<size_t>(2), static_cast<size_t>(8)));
+		return pool;
+	}
+};
 
 /// <summary>
 /// Represents a program created from a script.
@@ -2464,6 +6333,7 @@ public:
 	{
 		// init program
 		m_index = 0;
+		auto startTime = std::chrono::steady_clock::now();
 		CHISL_INDEX lines = static_cast<CHISL_INDEX>(m_commands.size());
 		int result;
 
@@ -2472,6 +6342,11 @@ public:
 		m_scope.set_constant(CONSTANT_RESULT, nullptr);
 		m_scope.set_constant(CONSTANT_PASS_COUNT, nullptr);
 		m_scope.set_constant(CONSTANT_FAIL_COUNT, nullptr);
+		m_scope.set_constant(CONSTANT_TIME, 0.0);
+		m_scope.set_constant(CONSTANT_MEMORY, 0.0);
+		m_scope.set_constant(CONSTANT_NEARBY_HITS, 0);
+		m_scope.set_constant(CONSTANT_NEARBY_MISSES, 0);
+		m_scope.set_constant(CONSTANT_PREFILTER_SKIPPED, 0.0);
 		m_scope.set_constant(CONSTANT_TRUE, 1);
 		m_scope.set_constant(CONSTANT_FALSE, 0);
 
@@ -2479,6 +6354,14 @@ public:
 		{
 			Command const& command = m_commands.at(m_index);
 
+			// milliseconds since the program started
+			std::chrono::duration<CHISL_NUMBER, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+			m_scope.set_constant(CONSTANT_TIME, elapsed.count());
+			m_scope.set_constant(CONSTANT_MEMORY, get_memory_usage());
+			m_scope.set_constant(CONSTANT_NEARBY_HITS, NearbyCounters::get_instance().hits.load());
+			m_scope.set_constant(CONSTANT_NEARBY_MISSES, NearbyCounters::get_instance().misses.load());
+			m_scope.set_constant(CONSTANT_PREFILTER_SKIPPED, PrefilterCounters::get_instance().get_skipped());
+
 			if (m_config.echo)
 			{
 				print(command.to_string());
@@ -2768,6 +6651,27 @@ public:
 		return value_to_number(value);
 	}
 
+	CHISL_NUMBER get_number(Command const& command, CHISL_INDEX const index) const
+	{
+		Token token = command.get_arg(index);
+
+		Value value = token.get_data();
+
+		// always check for variables
+		if (std::holds_alternative<CHISL_STRING>(value) && m_scope.contains(std::get<CHISL_STRING>(value)))
+		{
+			Value newValue = m_scope.get(std::get<CHISL_STRING>(value));
+
+			// replace if the variable held a value
+			if (!std::holds_alternative<std::nullptr_t>(newValue))
+			{
+				value = newValue;
+			}
+		}
+
+		return value_to_number(value);
+	}
+
 	CHISL_INT get_int(Command const command, CHISL_STRING const& name) const
 	{
 		return static_cast<CHISL_INT>(round(get_number(command, name)));
@@ -2840,6 +6744,252 @@ public:
 		return std::nullopt;
 	}
 
+	template<typename T>
+	std::optional<T> try_get_arg(Command const& command, CHISL_INDEX const index) const
+	{
+		Token token = command.get_arg(index);
+
+		Value value = token.get_data();
+
+		// always check for variables
+		if (std::holds_alternative<CHISL_STRING>(value) && m_scope.contains(std::get<CHISL_STRING>(value)))
+		{
+			Value newValue = m_scope.get(std::get<CHISL_STRING>(value));
+
+			// replace if the variable held a value
+			if (!std::holds_alternative<std::nullptr_t>(newValue))
+			{
+				value = newValue;
+			}
+		}
+
+		if (std::holds_alternative<T>(value))
+		{
+			return std::get<T>(value);
+		}
+
+		return std::nullopt;
+	}
+
+	/// <summary>
+	/// Gets the area of the match given as the region argument.
+	/// </summary>
+	/// <param name="command"></param>
+	/// <returns>The area, or nothing if the argument is not a match.</returns>
+	std::optional<cv::Rect> get_region_area(Command const& command) const
+	{
+		std::optional<Match> region = try_get_arg<Match>(command, "region");
+		if (!region.has_value())
+		{
+			return std::nullopt;
+		}
+
+		return cv::Rect(region.value().get_point(), cv::Size(region.value().get_size()));
+	}
+
+	/// <summary>
+	/// Runs a Find or Find all that only searches an area of the image, and stores what was found in the variable.
+	/// </summary>
+	/// <param name="command">The command, with a var, template and image.</param>
+	/// <param name="area">The area to search, or nothing if it was not given as a match.</param>
+	/// <param name="threshold"></param>
+	/// <param name="all">Whether to find every match, instead of the best.</param>
+	/// <returns>0 if it was searched, or the number of the argument that was not valid.</returns>
+	int find_in_area(Command const& command, std::optional<cv::Rect> const& area, CHISL_NUMBER const threshold, bool const all)
+	{
+		std::optional<Image> templateImage = try_get_arg<Image>(command, "template");
+		if (!templateImage.has_value())
+		{
+			m_scope.set_constant(CONSTANT_OUTPUT, nullptr);
+			return 1;
+		}
+
+		std::optional<Image> image = try_get_arg<Image>(command, "image");
+		if (!image.has_value())
+		{
+			m_scope.set_constant(CONSTANT_OUTPUT, nullptr);
+			return 2;
+		}
+
+		if (!area.has_value())
+		{
+			m_scope.set_constant(CONSTANT_OUTPUT, nullptr);
+			return 3;
+		}
+
+		Value found = nullptr;
+		if (all)
+		{
+			std::optional<MatchCollection> matches = find_all_within(image.value(), area.value(), templateImage.value(), threshold, get_find_options(command));
+			if (matches.has_value())
+			{
+				found = matches.value();
+			}
+		}
+		else
+		{
+			std::optional<Match> match = find_within(image.value(), area.value(), templateImage.value(), threshold, get_find_options(command));
+			if (match.has_value())
+			{
+				found = match.value();
+			}
+		}
+
+		m_scope.set(command.get_arg("var").to_string(), found);
+		m_scope.set_constant(CONSTANT_OUTPUT, found);
+		return 0;
+	}
+
+	/// <summary>
+	/// Runs a Find color or Find all color, and stores what was found in the variable.
+	/// </summary>
+	/// <param name="command">The command, with a var, color, optional tolerance and image, then optionally an area.</param>
+	/// <param name="withArea">Whether an area is given after the image, instead of searching the whole image.</param>
+	/// <param name="all">Whether to find every pixel of the color, instead of the first.</param>
+	/// <returns>0 if it was searched, or 1 if the image is not valid.</returns>
+	int find_color_in_image(Command const& command, bool const withArea, bool const all)
+	{
+		// the tolerance is optional, so the image is found from the end
+		CHISL_INDEX const imageIndex = command.get_arg_count() - (withArea ? 5 : 1);
+		CHISL_INT const tolerance = imageIndex > 4 ? static_cast<CHISL_INT>(std::round(get_number(command, 4))) : 0;
+
+		std::optional<Image> image = try_get_arg<Image>(command, imageIndex);
+		if (!image.has_value())
+		{
+			m_scope.set_constant(CONSTANT_OUTPUT, nullptr);
+			return 1;
+		}
+
+		cv::Rect area(0, 0, image.value().get_width(), image.value().get_height());
+		if (withArea)
+		{
+			area = cv::Rect(static_cast<int>(std::round(get_number(command, imageIndex + 1))), static_cast<int>(std::round(get_number(command, imageIndex + 2))),
+				static_cast<int>(std::round(get_number(command, imageIndex + 3))), static_cast<int>(std::round(get_number(command, imageIndex + 4))));
+		}
+
+		CHISL_INT const red = get_int(command, "red");
+		CHISL_INT const green = get_int(command, "green");
+		CHISL_INT const blue = get_int(command, "blue");
+
+		Value found = nullptr;
+		if (all)
+		{
+			std::optional<MatchCollection> matches = find_all_color(image.value(), area, red, green, blue, tolerance);
+			if (matches.has_value())
+			{
+				found = matches.value();
+			}
+		}
+		else
+		{
+			std::optional<Match> match = find_color(image.value(), area, red, green, blue, tolerance);
+			if (match.has_value())
+			{
+				found = match.value();
+			}
+		}
+
+		m_scope.set(command.get_arg("var").to_string(), found);
+		m_scope.set_constant(CONSTANT_OUTPUT, found);
+		return 0;
+	}
+
+	/// <summary>
+	/// Runs a Find any or Find each, which searches the image for every template listed between the variable and the image,
+	/// and stores what was found in the variable.
+	/// </summary>
+	/// <param name="command">The command, with a var, templates and image, then optionally a threshold and mode.</param>
+	/// <param name="withThreshold">Whether the threshold is given after the image, instead of using the default.</param>
+	/// <param name="any">Whether to keep only the template that matched best, instead of a match for each template.</param>
+	/// <returns>0 if it was searched, 1 if a template is not valid, or 2 if the image is not.</returns>
+	int find_templates(Command const& command, bool const withThreshold, bool const any)
+	{
+		// every argument between the variable and the image is a template, and the threshold and mode come after the image
+		CHISL_INDEX imageIndex = command.get_arg_count() - 1 - (withThreshold ? 1 : 0) - (get_mode_index(command).has_value() ? 1 : 0);
+
+		std::optional<std::vector<Image>> templates = get_images(command, 1, imageIndex);
+		if (!templates.has_value())
+		{
+			m_scope.set_constant(CONSTANT_OUTPUT, nullptr);
+			return 1;
+		}
+
+		std::optional<Image> image = try_get_arg<Image>(command, imageIndex);
+		if (!image.has_value())
+		{
+			m_scope.set_constant(CONSTANT_OUTPUT, nullptr);
+			return 2;
+		}
+
+		CHISL_NUMBER threshold = withThreshold ? get_number(command, imageIndex + 1) : DEFAULT_THRESHOLD;
+		std::vector<std::optional<std::pair<Match, CHISL_NUMBER>>> found = find_each(image.value(), templates.value(), threshold, get_find_options(command));
+
+		if (!any)
+		{
+			// templates that were not found get an empty match, so each match lines up with its template
+			std::vector<Match> matches;
+			matches.reserve(found.size());
+			for (auto const& result : found)
+			{
+				matches.push_back(result.has_value() ? result.value().first : Match());
+			}
+
+			MatchCollection collection(matches);
+			m_scope.set(command.get_arg("var").to_string(), collection);
+			m_scope.set_constant(CONSTANT_OUTPUT, collection);
+			return 0;
+		}
+
+		// the template that matched best wins
+		std::optional<size_t> best;
+		for (size_t i = 0; i < found.size(); i++)
+		{
+			if (found[i].has_value() && (!best.has_value() || found[i].value().second > found[best.value()].value().second))
+			{
+				best = i;
+			}
+		}
+
+		if (best.has_value())
+		{
+			m_scope.set(command.get_arg("var").to_string(), found[best.value()].value().first);
+			m_scope.set_constant(CONSTANT_OUTPUT, static_cast<CHISL_INT>(best.value()));
+		}
+		else
+		{
+			m_scope.set(command.get_arg("var").to_string(), nullptr);
+			m_scope.set_constant(CONSTANT_OUTPUT, nullptr);
+		}
+
+		return 0;
+	}
+
+	/// <summary>
+	/// Gets the images of the arguments from the first index up to, but not including, the last index.
+	/// </summary>
+	/// <param name="command"></param>
+	/// <param name="first"></param>
+	/// <param name="last"></param>
+	/// <returns>The images, or nothing if any of the arguments is not an image.</returns>
+	std::optional<std::vector<Image>> get_images(Command const& command, CHISL_INDEX const first, CHISL_INDEX const last) const
+	{
+		std::vector<Image> images;
+
+		for (CHISL_INDEX i = first; i < last; i++)
+		{
+			std::optional<Image> image = try_get_arg<Image>(command, i);
+			if (!image.has_value())
+			{
+				std::cerr << "\"" << command.get_arg(i).to_string() << "\" is not an image.\n";
+				return std::nullopt;
+			}
+
+			images.push_back(image.value());
+		}
+
+		return images;
+	}
+
 	CHISL_INDEX get_time(Command const& command, CHISL_STRING const& value, CHISL_STRING const& unit)
 	{
 		CHISL_NUMBER valueNumber = get_number(command, value);
@@ -2856,10 +7006,129 @@ public:
 			return static_cast<CHISL_INDEX>(valueNumber * 60000.0);
 		} else if (unitStr == "h")
 		{
-			return static_cast<CHISL_INDEX>(valueNumber * 3600000.0);
+			return static_cast<CHISL_INDEX>(valueNumber * 3600000.0);
+		}
+
+		return 0;
+	}
+
+	/// <summary>
+	/// Gets the name of the text profile the first text command in the program reads with,
+	/// taking any Configure of textProfile before it into account.
+	/// </summary>
+	/// <returns>The profile name, or nothing if the program does not read text or reads it with a glyph set.</returns>
+	std::optional<CHISL_STRING> get_first_text_profile() const
+	{
+		CHISL_STRING configured = m_config.read.profile;
+
+		for (Command const& command : m_commands)
+		{
+			CHISL_STRING profile;
+
+			switch (command.get_token())
+			{
+			case CHISL_KEYWORD_CONFIGURE:
+				// the profile the script switches to before reading is the one it will use
+				if (command.get_arg("setting").to_string() == "textProfile")
+				{
+					configured = string_to_lower(command.get_arg("value").to_string());
+				}
+				break;
+			case CHISL_KEYWORD_FIND_TEXT:
+			case CHISL_KEYWORD_FIND_TEXT_WITH:
+			case CHISL_KEYWORD_FIND_ALL_TEXT:
+			case CHISL_KEYWORD_FIND_ALL_TEXT_WITH:
+			case CHISL_KEYWORD_READ:
+			case CHISL_KEYWORD_READ_ALL:
+				profile = command.get_param("profile").index < command.get_arg_count()
+					? string_to_lower(command.get_arg("profile").to_string())
+					: configured;
+
+				// glyph sets do not use an engine
+				if (get_text_profile(profile).has_value())
+				{
+					return profile;
+				}
+				return std::nullopt;
+			default:
+				break;
+			}
+		}
+
+		return std::nullopt;
+	}
+
+	/// <summary>
+	/// Gets the index of the find mode given after "using", if the command was given one.
+	/// Commands with a list of templates have no fixed index for it, so it is the last argument when the command ends with one.
+	/// </summary>
+	/// <param name="command">The find command.</param>
+	/// <returns>The index of the mode, or nothing if the configured mode is used.</returns>
+	std::optional<CHISL_INDEX> get_mode_index(Command const& command) const
+	{
+		switch (command.get_token())
+		{
+		case CHISL_KEYWORD_FIND_ANY:
+		case CHISL_KEYWORD_FIND_ANY_WITH:
+		case CHISL_KEYWORD_FIND_EACH:
+		case CHISL_KEYWORD_FIND_EACH_WITH:
+		{
+			static CHISL_REGEX const re("\\busing " INPUT_PATTERN_VARIABLE "\\.\\s*$", std::regex_constants::icase);
+			if (std::regex_search(command.get_text(), re))
+			{
+				return command.get_arg_count() - 1;
+			}
+			return std::nullopt;
+		}
+		default:
+			if (command.get_param("mode").index < command.get_arg_count())
+			{
+				return command.get_param("mode").index;
+			}
+			return std::nullopt;
+		}
+	}
+
+	FindOptions get_find_options(Command const& command) const
+	{
+		FindOptions options = m_config.find;
+
+		// use the mode given with the command over the configured one
+		std::optional<CHISL_INDEX> index = get_mode_index(command);
+		if (index.has_value())
+		{
+			CHISL_STRING mode = get_string(command, index.value());
+
+			std::optional<ColorMode> color = string_to_color_mode(mode);
+			std::optional<FindMethod> method = string_to_find_method(mode);
+			if (color.has_value())
+			{
+				options.color = color.value();
+			}
+			else if (method.has_value())
+			{
+				options.method = method.value();
+			}
+			else
+			{
+				std::cerr << "Unknown find mode \"" << mode << "\".\n";
+			}
+		}
+
+		return options;
+	}
+
+	ReadOptions get_read_options(Command const& command) const
+	{
+		ReadOptions options = m_config.read;
+
+		// use the profile given with the command over the configured one
+		if (command.get_param("profile").index < command.get_arg_count())
+		{
+			options.profile = get_string(command, "profile");
 		}
 
-		return 0;
+		return options;
 	}
 
 	int execute(Command const& command)
@@ -2913,13 +7182,14 @@ public:
 		{
 			Token const& token = tokens.at(i);
 
-			if (token.get_token() == CHISL_FILLER || (token.get_token() >= CHISL_KEYWORD_FIRST && token.get_token() <= CHISL_KEYWORD_LAST))
+			if (token.get_token() == CHISL_FILLER || (token.get_token() >= CHISL_KEYWORD_FIRST && token.get_token() <= CHISL_KEYWORD_LAST)
+				|| (token.get_token() == CHISL_GENERIC && cmdTemplate->is_filler(token.to_string())))
 			{
 				tokens.erase(tokens.begin() + i);
 			}
 		}
 
-		return Command(*cmdTemplate, row, tokens);
+		return Command(*cmdTemplate, row, tokens, str);
 	}
 
 	static CommandTemplate get_template(ChislToken const token)
@@ -2971,6 +7241,12 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 				std::optional<Value> value = file_read(path);
 				if (value.has_value())
 				{
+					// get the image ready to be found, the first time it is loaded
+					if (std::holds_alternative<Image>(value.value()))
+					{
+						prepare_template(std::get<Image>(value.value()), program.get_config().find);
+					}
+
 					program.get_scope().set(command.get_arg("var").to_string(), value.value());
 
 					program.get_scope().set_constant(CONSTANT_OUTPUT, value.value());
@@ -3077,8 +7353,9 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 		[](Command const& command, Program& program) {
 			// get the collection
 			std::optional<MatchCollection> collection = program.try_get_arg<MatchCollection>(command, "collection");
+			std::optional<TextCollection> textCollection = program.try_get_arg<TextCollection>(command, "collection");
 
-			if (!collection.has_value())
+			if (!collection.has_value() && !textCollection.has_value())
 			{
 				program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
 
@@ -3087,8 +7364,9 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 
 			// get the index
 			CHISL_INT index = program.get_int(command, "index");
+			size_t count = collection.has_value() ? collection.value().count() : textCollection.value().count();
 
-			if (index >= collection.value().count())
+			if (index < 0 || index >= count)
 			{
 				program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
 
@@ -3097,7 +7375,7 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 
 			CHISL_STRING name = command.get_arg("var").to_string();
 
-			Value value = collection.value().get(index);
+			Value value = collection.has_value() ? Value(collection.value().get(index)) : Value(textCollection.value().get(index));
 			program.get_scope().set(name, value);
 
 			program.get_scope().set_constant(CONSTANT_OUTPUT, value);
@@ -3113,8 +7391,9 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 		[](Command const& command, Program& program) {
 			// get the collection
 			std::optional<MatchCollection> collection = program.try_get_arg<MatchCollection>(command, "collection");
+			std::optional<TextCollection> textCollection = program.try_get_arg<TextCollection>(command, "collection");
 
-			if (!collection.has_value())
+			if (!collection.has_value() && !textCollection.has_value())
 			{
 				program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
 
@@ -3123,7 +7402,7 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 
 			CHISL_STRING name = command.get_arg("var").to_string();
 
-			CHISL_INT count = static_cast<CHISL_INT>(collection.value().count());
+			CHISL_INT count = static_cast<CHISL_INT>(collection.has_value() ? collection.value().count() : textCollection.value().count());
 			program.get_scope().set(name, count);
 
 			program.get_scope().set_constant(CONSTANT_OUTPUT, count);
@@ -3154,28 +7433,72 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 		{ 4, "h", CHISL_TYPE_INT }
 		},
 		[](Command const& command, Program& program) {
-			Image image = screenshot();
-			CHISL_INT screenWidth = image.get_width();
-			CHISL_INT screenHeight = image.get_height();
-
-			CHISL_INT x = std::clamp(program.get_int(command, "x"), 0, screenWidth);
-			CHISL_INT y = std::clamp(program.get_int(command, "y"), 0, screenHeight);
-
-			CHISL_INT w = std::clamp(program.get_int(command, "w"), 0, screenWidth - x);
-			CHISL_INT h = std::clamp(program.get_int(command, "h"), 0, screenHeight - y);
+			// only copy the part of the screen that is needed
+			Image image = screenshot(cv::Rect(program.get_int(command, "x"), program.get_int(command, "y"), program.get_int(command, "w"), program.get_int(command, "h")));
 
 			// if w and h not ok, stop
-			if (w == 0 || h == 0)
+			if (image.empty())
 			{
 				program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
 				return 0;
 			}
 
-			image = crop(image, x, y, w, h);
 			program.get_scope().set(command.get_arg("var").to_string(), image);
 
 			program.get_scope().set_constant(CONSTANT_OUTPUT, image);
 
+			return 0;
+		}) },
+	{ CHISL_KEYWORD_GET_COLOR, CommandTemplate(CHISL_KEYWORD_GET_COLOR,
+		"get color " INPUT_PATTERN_VARIABLE " at " INPUT_PATTERN_INT " " INPUT_PATTERN_INT "\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "x", CHISL_TYPE_INT },
+		{ 2, "y", CHISL_TYPE_INT }
+		},
+		[](Command const& command, Program& program) {
+			std::optional<cv::Vec3b> pixel = get_screen_pixel(program.get_int(command, "x"), program.get_int(command, "y"));
+			if (!pixel.has_value())
+			{
+				program.get_scope().set(command.get_arg("var").to_string(), nullptr);
+				program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
+				return 1;
+			}
+
+			CHISL_STRING color = std::format("#{:02X}{:02X}{:02X}", pixel.value()[2], pixel.value()[1], pixel.value()[0]);
+			program.get_scope().set(command.get_arg("var").to_string(), color);
+
+			program.get_scope().set_constant(CONSTANT_OUTPUT, color);
+
+			return 0;
+		}) },
+	{ CHISL_KEYWORD_GET_COLOR_CHANNELS, CommandTemplate(CHISL_KEYWORD_GET_COLOR_CHANNELS,
+		"get color " INPUT_PATTERN_VARIABLE " " INPUT_PATTERN_VARIABLE " " INPUT_PATTERN_VARIABLE " at " INPUT_PATTERN_INT " " INPUT_PATTERN_INT "\\.\\s*$",
+		{
+		{ 0, "red", CHISL_TYPE_VARIABLE },
+		{ 1, "green", CHISL_TYPE_VARIABLE },
+		{ 2, "blue", CHISL_TYPE_VARIABLE },
+		{ 3, "x", CHISL_TYPE_INT },
+		{ 4, "y", CHISL_TYPE_INT }
+		},
+		[](Command const& command, Program& program) {
+			std::optional<cv::Vec3b> pixel = get_screen_pixel(program.get_int(command, "x"), program.get_int(command, "y"));
+			if (!pixel.has_value())
+			{
+				program.get_scope().set(command.get_arg("red").to_string(), nullptr);
+				program.get_scope().set(command.get_arg("green").to_string(), nullptr);
+				program.get_scope().set(command.get_arg("blue").to_string(), nullptr);
+				program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
+				return 1;
+			}
+
+			// numbers, so they can be given straight to Find color
+			program.get_scope().set(command.get_arg("red").to_string(), static_cast<CHISL_INT>(pixel.value()[2]));
+			program.get_scope().set(command.get_arg("green").to_string(), static_cast<CHISL_INT>(pixel.value()[1]));
+			program.get_scope().set(command.get_arg("blue").to_string(), static_cast<CHISL_INT>(pixel.value()[0]));
+
+			program.get_scope().set_constant(CONSTANT_OUTPUT, std::format("#{:02X}{:02X}{:02X}", pixel.value()[2], pixel.value()[1], pixel.value()[0]));
+
 			return 0;
 		}) },
 	{ CHISL_KEYWORD_CROP, CommandTemplate(CHISL_KEYWORD_CROP,
@@ -3217,11 +7540,12 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 			return 0;
 		}) },
 	{ CHISL_KEYWORD_FIND, CommandTemplate(CHISL_KEYWORD_FIND,
-		"find " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE "\\.\\s*$",
+		"find " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
 		{
 		{ 0, "var", CHISL_TYPE_VARIABLE },
 		{ 1, "template", CHISL_TYPE_VARIABLE },
-		{ 2, "image", CHISL_TYPE_VARIABLE }
+		{ 2, "image", CHISL_TYPE_VARIABLE },
+		{ 3, "mode", CHISL_TYPE_VARIABLE }
 		},
 		[](Command const& command, Program& program) {
 			std::optional<Image> templateImage = program.try_get_arg<Image>(command, "template");
@@ -3238,7 +7562,7 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 				return 2;
 			}
 
-			std::optional<Match> found = find(image.value(), templateImage.value(), DEFAULT_THRESHOLD);
+			std::optional<Match> found = find(image.value(), templateImage.value(), DEFAULT_THRESHOLD, program.get_find_options(command));
 			if (found.has_value())
 			{
 				program.get_scope().set(command.get_arg("var").to_string(), found.value());
@@ -3253,12 +7577,13 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 			return 0;
 		}) },
 	{ CHISL_KEYWORD_FIND_WITH, CommandTemplate(CHISL_KEYWORD_FIND_WITH,
-		"find " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE " with " INPUT_PATTERN_NUMBER "\\.\\s*$",
+		"find " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE " with " INPUT_PATTERN_NUMBER "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
 		{
 		{ 0, "var", CHISL_TYPE_VARIABLE },
 		{ 1, "template", CHISL_TYPE_VARIABLE },
 		{ 2, "image", CHISL_TYPE_VARIABLE },
-		{ 3, "threshold", CHISL_TYPE_NUMBER }
+		{ 3, "threshold", CHISL_TYPE_NUMBER },
+		{ 4, "mode", CHISL_TYPE_VARIABLE }
 		},
 		[](Command const& command, Program& program) {
 			std::optional<Image> templateImage = program.try_get_arg<Image>(command, "template");
@@ -3276,7 +7601,7 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 			}
 
 			CHISL_NUMBER threshold = program.get_number(command, "threshold");
-			std::optional<Match> found = find(image.value(), templateImage.value(), threshold);
+			std::optional<Match> found = find(image.value(), templateImage.value(), threshold, program.get_find_options(command));
 			if (found.has_value())
 			{
 				program.get_scope().set_constant(CONSTANT_OUTPUT, found.value());
@@ -3291,11 +7616,12 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 			return 0;
 		}) },
 	{ CHISL_KEYWORD_FIND_ALL, CommandTemplate(CHISL_KEYWORD_FIND_ALL,
-		"find all " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE "\\.\\s*$",
+		"find all " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
 		{
 		{ 0, "var", CHISL_TYPE_VARIABLE },
 		{ 1, "template", CHISL_TYPE_VARIABLE },
-		{ 2, "image", CHISL_TYPE_VARIABLE }
+		{ 2, "image", CHISL_TYPE_VARIABLE },
+		{ 3, "mode", CHISL_TYPE_VARIABLE }
 		},
 		[](Command const& command, Program& program) {
 			std::optional<Image> templateImage = program.try_get_arg<Image>(command, "template");
@@ -3312,7 +7638,7 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 				return 2;
 			}
 
-			std::optional<MatchCollection> found = find_all(image.value(), templateImage.value(), DEFAULT_THRESHOLD);
+			std::optional<MatchCollection> found = find_all(image.value(), templateImage.value(), DEFAULT_THRESHOLD, program.get_find_options(command));
 			if (found.has_value())
 			{
 				program.get_scope().set_constant(CONSTANT_OUTPUT, found.value());
@@ -3327,12 +7653,13 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 			return 0;
 		}) },
 	{ CHISL_KEYWORD_FIND_ALL_WITH, CommandTemplate(CHISL_KEYWORD_FIND_ALL_WITH,
-		"find all " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE " with " INPUT_PATTERN_NUMBER "\\.\\s*$",
+		"find all " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE " with " INPUT_PATTERN_NUMBER "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
 		{
 		{ 0, "var", CHISL_TYPE_VARIABLE },
 		{ 1, "template", CHISL_TYPE_VARIABLE },
 		{ 2, "image", CHISL_TYPE_VARIABLE },
-		{ 3, "threshold", CHISL_TYPE_NUMBER }
+		{ 3, "threshold", CHISL_TYPE_NUMBER },
+		{ 4, "mode", CHISL_TYPE_VARIABLE }
 		},
 		[](Command const& command, Program& program) {
 			std::optional<Image> templateImage = program.try_get_arg<Image>(command, "template");
@@ -3350,7 +7677,7 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 			}
 
 			CHISL_NUMBER threshold = program.get_number(command, "threshold");
-			std::optional<MatchCollection> found = find_all(image.value(), templateImage.value(), threshold);
+			std::optional<MatchCollection> found = find_all(image.value(), templateImage.value(), threshold, program.get_find_options(command));
 			if (found.has_value())
 			{
 				program.get_scope().set_constant(CONSTANT_OUTPUT, found.value());
@@ -3364,13 +7691,210 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 
 			return 0;
 		}) },
+	{ CHISL_KEYWORD_FIND_AT, CommandTemplate(CHISL_KEYWORD_FIND_AT,
+		"find " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE " at " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "template", CHISL_TYPE_VARIABLE },
+		{ 2, "image", CHISL_TYPE_VARIABLE },
+		{ 3, "x", CHISL_TYPE_INT },
+		{ 4, "y", CHISL_TYPE_INT },
+		{ 5, "w", CHISL_TYPE_INT },
+		{ 6, "h", CHISL_TYPE_INT },
+		{ 7, "mode", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_in_area(command, cv::Rect(program.get_int(command, "x"), program.get_int(command, "y"), program.get_int(command, "w"), program.get_int(command, "h")), DEFAULT_THRESHOLD, false);
+		}) },
+	{ CHISL_KEYWORD_FIND_AT_WITH, CommandTemplate(CHISL_KEYWORD_FIND_AT_WITH,
+		"find " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE " at " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " with " INPUT_PATTERN_NUMBER "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "template", CHISL_TYPE_VARIABLE },
+		{ 2, "image", CHISL_TYPE_VARIABLE },
+		{ 3, "x", CHISL_TYPE_INT },
+		{ 4, "y", CHISL_TYPE_INT },
+		{ 5, "w", CHISL_TYPE_INT },
+		{ 6, "h", CHISL_TYPE_INT },
+		{ 7, "threshold", CHISL_TYPE_NUMBER },
+		{ 8, "mode", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_in_area(command, cv::Rect(program.get_int(command, "x"), program.get_int(command, "y"), program.get_int(command, "w"), program.get_int(command, "h")), program.get_number(command, "threshold"), false);
+		}) },
+	{ CHISL_KEYWORD_FIND_WITHIN, CommandTemplate(CHISL_KEYWORD_FIND_WITHIN,
+		"find " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE " within " INPUT_PATTERN_VARIABLE "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "template", CHISL_TYPE_VARIABLE },
+		{ 2, "image", CHISL_TYPE_VARIABLE },
+		{ 3, "region", CHISL_TYPE_VARIABLE },
+		{ 4, "mode", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_in_area(command, program.get_region_area(command), DEFAULT_THRESHOLD, false);
+		}) },
+	{ CHISL_KEYWORD_FIND_WITHIN_WITH, CommandTemplate(CHISL_KEYWORD_FIND_WITHIN_WITH,
+		"find " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE " within " INPUT_PATTERN_VARIABLE " with " INPUT_PATTERN_NUMBER "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "template", CHISL_TYPE_VARIABLE },
+		{ 2, "image", CHISL_TYPE_VARIABLE },
+		{ 3, "region", CHISL_TYPE_VARIABLE },
+		{ 4, "threshold", CHISL_TYPE_NUMBER },
+		{ 5, "mode", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_in_area(command, program.get_region_area(command), program.get_number(command, "threshold"), false);
+		}) },
+	{ CHISL_KEYWORD_FIND_ALL_AT, CommandTemplate(CHISL_KEYWORD_FIND_ALL_AT,
+		"find all " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE " at " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "template", CHISL_TYPE_VARIABLE },
+		{ 2, "image", CHISL_TYPE_VARIABLE },
+		{ 3, "x", CHISL_TYPE_INT },
+		{ 4, "y", CHISL_TYPE_INT },
+		{ 5, "w", CHISL_TYPE_INT },
+		{ 6, "h", CHISL_TYPE_INT },
+		{ 7, "mode", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_in_area(command, cv::Rect(program.get_int(command, "x"), program.get_int(command, "y"), program.get_int(command, "w"), program.get_int(command, "h")), DEFAULT_THRESHOLD, true);
+		}) },
+	{ CHISL_KEYWORD_FIND_ALL_AT_WITH, CommandTemplate(CHISL_KEYWORD_FIND_ALL_AT_WITH,
+		"find all " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE " at " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " with " INPUT_PATTERN_NUMBER "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "template", CHISL_TYPE_VARIABLE },
+		{ 2, "image", CHISL_TYPE_VARIABLE },
+		{ 3, "x", CHISL_TYPE_INT },
+		{ 4, "y", CHISL_TYPE_INT },
+		{ 5, "w", CHISL_TYPE_INT },
+		{ 6, "h", CHISL_TYPE_INT },
+		{ 7, "threshold", CHISL_TYPE_NUMBER },
+		{ 8, "mode", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_in_area(command, cv::Rect(program.get_int(command, "x"), program.get_int(command, "y"), program.get_int(command, "w"), program.get_int(command, "h")), program.get_number(command, "threshold"), true);
+		}) },
+	{ CHISL_KEYWORD_FIND_ALL_WITHIN, CommandTemplate(CHISL_KEYWORD_FIND_ALL_WITHIN,
+		"find all " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE " within " INPUT_PATTERN_VARIABLE "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "template", CHISL_TYPE_VARIABLE },
+		{ 2, "image", CHISL_TYPE_VARIABLE },
+		{ 3, "region", CHISL_TYPE_VARIABLE },
+		{ 4, "mode", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_in_area(command, program.get_region_area(command), DEFAULT_THRESHOLD, true);
+		}) },
+	{ CHISL_KEYWORD_FIND_ALL_WITHIN_WITH, CommandTemplate(CHISL_KEYWORD_FIND_ALL_WITHIN_WITH,
+		"find all " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE " in " INPUT_PATTERN_VARIABLE " within " INPUT_PATTERN_VARIABLE " with " INPUT_PATTERN_NUMBER "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "template", CHISL_TYPE_VARIABLE },
+		{ 2, "image", CHISL_TYPE_VARIABLE },
+		{ 3, "region", CHISL_TYPE_VARIABLE },
+		{ 4, "threshold", CHISL_TYPE_NUMBER },
+		{ 5, "mode", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_in_area(command, program.get_region_area(command), program.get_number(command, "threshold"), true);
+		}) },
+	{ CHISL_KEYWORD_FIND_COLOR, CommandTemplate(CHISL_KEYWORD_FIND_COLOR,
+		"find color " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT "( tolerance " INPUT_PATTERN_INT ")? in " INPUT_PATTERN_VARIABLE "\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "red", CHISL_TYPE_INT },
+		{ 2, "green", CHISL_TYPE_INT },
+		{ 3, "blue", CHISL_TYPE_INT },
+		{ 4, "tolerance", CHISL_TYPE_INT }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_color_in_image(command, false, false);
+		}) },
+	{ CHISL_KEYWORD_FIND_COLOR_AT, CommandTemplate(CHISL_KEYWORD_FIND_COLOR_AT,
+		"find color " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT "( tolerance " INPUT_PATTERN_INT ")? in " INPUT_PATTERN_VARIABLE " at " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT "\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "red", CHISL_TYPE_INT },
+		{ 2, "green", CHISL_TYPE_INT },
+		{ 3, "blue", CHISL_TYPE_INT },
+		{ 4, "tolerance", CHISL_TYPE_INT }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_color_in_image(command, true, false);
+		}) },
+	{ CHISL_KEYWORD_FIND_ALL_COLOR, CommandTemplate(CHISL_KEYWORD_FIND_ALL_COLOR,
+		"find all color " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT "( tolerance " INPUT_PATTERN_INT ")? in " INPUT_PATTERN_VARIABLE "\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "red", CHISL_TYPE_INT },
+		{ 2, "green", CHISL_TYPE_INT },
+		{ 3, "blue", CHISL_TYPE_INT },
+		{ 4, "tolerance", CHISL_TYPE_INT }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_color_in_image(command, false, true);
+		}) },
+	{ CHISL_KEYWORD_FIND_ALL_COLOR_AT, CommandTemplate(CHISL_KEYWORD_FIND_ALL_COLOR_AT,
+		"find all color " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT "( tolerance " INPUT_PATTERN_INT ")? in " INPUT_PATTERN_VARIABLE " at " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT " " INPUT_PATTERN_INT "\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "red", CHISL_TYPE_INT },
+		{ 2, "green", CHISL_TYPE_INT },
+		{ 3, "blue", CHISL_TYPE_INT },
+		{ 4, "tolerance", CHISL_TYPE_INT }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_color_in_image(command, true, true);
+		}) },
+	{ CHISL_KEYWORD_FIND_ANY, CommandTemplate(CHISL_KEYWORD_FIND_ANY,
+		"find any " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE "(, ?" INPUT_PATTERN_VARIABLE ")* in " INPUT_PATTERN_VARIABLE "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "templates", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_templates(command, false, true);
+		}) },
+	{ CHISL_KEYWORD_FIND_ANY_WITH, CommandTemplate(CHISL_KEYWORD_FIND_ANY_WITH,
+		"find any " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE "(, ?" INPUT_PATTERN_VARIABLE ")* in " INPUT_PATTERN_VARIABLE " with " INPUT_PATTERN_NUMBER "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "templates", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_templates(command, true, true);
+		}) },
+	{ CHISL_KEYWORD_FIND_EACH, CommandTemplate(CHISL_KEYWORD_FIND_EACH,
+		"find each " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE "(, ?" INPUT_PATTERN_VARIABLE ")* in " INPUT_PATTERN_VARIABLE "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "templates", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_templates(command, false, false);
+		}) },
+	{ CHISL_KEYWORD_FIND_EACH_WITH, CommandTemplate(CHISL_KEYWORD_FIND_EACH_WITH,
+		"find each " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_VARIABLE "(, ?" INPUT_PATTERN_VARIABLE ")* in " INPUT_PATTERN_VARIABLE " with " INPUT_PATTERN_NUMBER "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "templates", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			return program.find_templates(command, true, false);
+		}) },
 	{ CHISL_KEYWORD_FIND_TEXT, CommandTemplate(CHISL_KEYWORD_FIND_TEXT,
-		"find text " INPUT_PATTERN_TEXT " " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_STRING " in " INPUT_PATTERN_VARIABLE "\\.\\s*$",
+		"find text " INPUT_PATTERN_TEXT " " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_STRING " in " INPUT_PATTERN_VARIABLE "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
 		{
 		{ 0, "type", CHISL_TYPE_TEXT },
 		{ 1, "var", CHISL_TYPE_VARIABLE },
 		{ 2, "text", CHISL_TYPE_STRING },
-		{ 3, "image", CHISL_TYPE_VARIABLE }
+		{ 3, "image", CHISL_TYPE_VARIABLE },
+		{ 4, "profile", CHISL_TYPE_VARIABLE }
 		},
 		[](Command const& command, Program& program) {
 			CHISL_STRING templateText = program.get_string(command, "text");
@@ -3382,7 +7906,7 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 				return 1;
 			}
 			tesseract::PageIteratorLevel pil = string_to_pil(command.get_arg("type").to_string());
-			std::optional<Match> found = find_text(image.value(), templateText, pil, DEFAULT_THRESHOLD);
+			std::optional<Match> found = find_text(image.value(), templateText, pil, DEFAULT_THRESHOLD, program.get_read_options(command));
 			if (found.has_value())
 			{
 				program.get_scope().set_constant(CONSTANT_OUTPUT, found.value());
@@ -3397,13 +7921,14 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 			return 0;
 		}) },
 	{ CHISL_KEYWORD_FIND_TEXT_WITH, CommandTemplate(CHISL_KEYWORD_FIND_TEXT_WITH,
-		"find text " INPUT_PATTERN_TEXT " " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_STRING " in " INPUT_PATTERN_VARIABLE " with " INPUT_PATTERN_NUMBER "\\.\\s*$",
+		"find text " INPUT_PATTERN_TEXT " " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_STRING " in " INPUT_PATTERN_VARIABLE " with " INPUT_PATTERN_NUMBER "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
 		{
 		{ 0, "type", CHISL_TYPE_TEXT },
 		{ 1, "var", CHISL_TYPE_VARIABLE },
 		{ 2, "text", CHISL_TYPE_STRING },
 		{ 3, "image", CHISL_TYPE_VARIABLE },
-		{ 4, "threshold", CHISL_TYPE_NUMBER }
+		{ 4, "threshold", CHISL_TYPE_NUMBER },
+		{ 5, "profile", CHISL_TYPE_VARIABLE }
 		},
 		[](Command const& command, Program& program) {
 			CHISL_STRING templateText = program.get_string(command, "text");
@@ -3417,7 +7942,7 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 
 			CHISL_NUMBER threshold = program.get_number(command, "threshold");
 			tesseract::PageIteratorLevel pil = string_to_pil(command.get_arg("type").to_string());
-			std::optional<Match> found = find_text(image.value(), templateText, pil, threshold);
+			std::optional<Match> found = find_text(image.value(), templateText, pil, threshold, program.get_read_options(command));
 			if (found.has_value())
 			{
 				program.get_scope().set_constant(CONSTANT_OUTPUT, found.value());
@@ -3432,12 +7957,13 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 			return 0;
 		}) },
 	{ CHISL_KEYWORD_FIND_ALL_TEXT, CommandTemplate(CHISL_KEYWORD_FIND_ALL_TEXT,
-		"find all text " INPUT_PATTERN_TEXT " " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_STRING " in " INPUT_PATTERN_VARIABLE "\\.\\s*$",
+		"find all text " INPUT_PATTERN_TEXT " " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_STRING " in " INPUT_PATTERN_VARIABLE "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
 		{
 		{ 0, "type", CHISL_TYPE_TEXT },
 		{ 1, "var", CHISL_TYPE_VARIABLE },
 		{ 2, "text", CHISL_TYPE_STRING },
-		{ 3, "image", CHISL_TYPE_VARIABLE }
+		{ 3, "image", CHISL_TYPE_VARIABLE },
+		{ 4, "profile", CHISL_TYPE_VARIABLE }
 		},
 		[](Command const& command, Program& program) {
 			CHISL_STRING templateText = program.get_string(command, "text");
@@ -3450,7 +7976,7 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 			}
 
 			tesseract::PageIteratorLevel pil = string_to_pil(command.get_arg("type").to_string());
-			std::optional<MatchCollection> found = find_all_text(image.value(), templateText, pil, DEFAULT_THRESHOLD);
+			std::optional<MatchCollection> found = find_all_text(image.value(), templateText, pil, DEFAULT_THRESHOLD, program.get_read_options(command));
 			if (found.has_value())
 			{
 				program.get_scope().set_constant(CONSTANT_OUTPUT, found.value());
@@ -3465,13 +7991,14 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 			return 0;
 		}) },
 	{ CHISL_KEYWORD_FIND_ALL_TEXT_WITH, CommandTemplate(CHISL_KEYWORD_FIND_ALL_TEXT_WITH,
-		"find all text " INPUT_PATTERN_TEXT " " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_STRING " in " INPUT_PATTERN_VARIABLE " with " INPUT_PATTERN_NUMBER "\\.\\s*$",
+		"find all text " INPUT_PATTERN_TEXT " " INPUT_PATTERN_VARIABLE " by " INPUT_PATTERN_STRING " in " INPUT_PATTERN_VARIABLE " with " INPUT_PATTERN_NUMBER "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
 		{
 		{ 0, "type", CHISL_TYPE_TEXT },
 		{ 1, "var", CHISL_TYPE_VARIABLE },
 		{ 2, "text", CHISL_TYPE_STRING },
 		{ 3, "image", CHISL_TYPE_VARIABLE },
-		{ 4, "threshold", CHISL_TYPE_NUMBER }
+		{ 4, "threshold", CHISL_TYPE_NUMBER },
+		{ 5, "profile", CHISL_TYPE_VARIABLE }
 		},
 		[](Command const& command, Program& program) {
 			CHISL_STRING templateText = program.get_string(command, "text");
@@ -3485,7 +8012,7 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 
 			CHISL_NUMBER threshold = program.get_number(command, "threshold");
 			tesseract::PageIteratorLevel pil = string_to_pil(command.get_arg("type").to_string());
-			std::optional<MatchCollection> found = find_all_text(image.value(), templateText, pil, threshold);
+			std::optional<MatchCollection> found = find_all_text(image.value(), templateText, pil, threshold, program.get_read_options(command));
 			if (found.has_value())
 			{
 				program.get_scope().set_constant(CONSTANT_OUTPUT, found.value());
@@ -3500,10 +8027,11 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 			return 0;
 		}) },
 	{ CHISL_KEYWORD_READ, CommandTemplate(CHISL_KEYWORD_READ,
-		"read " INPUT_PATTERN_VARIABLE " from " INPUT_PATTERN_VARIABLE "\\.\\s*$",
+		"read " INPUT_PATTERN_VARIABLE " from " INPUT_PATTERN_VARIABLE "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
 		{
 		{ 0, "var", CHISL_TYPE_VARIABLE },
-		{ 1, "image", CHISL_TYPE_VARIABLE }
+		{ 1, "image", CHISL_TYPE_VARIABLE },
+		{ 2, "profile", CHISL_TYPE_VARIABLE }
 		},
 		[](Command const& command, Program& program) {
 			std::optional<Image> image = program.try_get_arg<Image>(command, "image");
@@ -3513,13 +8041,94 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 				return 1;
 			}
 
-			CHISL_STRING text = read_from_image(image.value());
+			CHISL_STRING text = read_from_image(image.value(), program.get_read_options(command));
 
 			CHISL_STRING name = command.get_arg("var").to_string();
 			program.get_scope().set(name, text);
 
 			program.get_scope().set_constant(CONSTANT_OUTPUT, text);
 
+			return 0;
+		}) },
+	{ CHISL_KEYWORD_READ_ALL, CommandTemplate(CHISL_KEYWORD_READ_ALL,
+		"read all " INPUT_PATTERN_VARIABLE " from " INPUT_PATTERN_VARIABLE " at " INPUT_PATTERN_VARIABLE "( using " INPUT_PATTERN_VARIABLE ")?\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE },
+		{ 1, "image", CHISL_TYPE_VARIABLE },
+		{ 2, "matches", CHISL_TYPE_VARIABLE },
+		{ 3, "profile", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			std::optional<Image> image = program.try_get_arg<Image>(command, "image");
+			if (!image.has_value())
+			{
+				program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
+				return 1;
+			}
+
+			// a single match is read as a collection of one
+			std::optional<MatchCollection> matches = program.try_get_arg<MatchCollection>(command, "matches");
+			if (!matches.has_value())
+			{
+				std::optional<Match> match = program.try_get_arg<Match>(command, "matches");
+				if (!match.has_value())
+				{
+					program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
+					return 2;
+				}
+
+				matches = MatchCollection(std::vector<Match>{ match.value() });
+			}
+
+			std::optional<TextCollection> texts = read_all_from_image(image.value(), matches.value(), program.get_read_options(command));
+			if (!texts.has_value())
+			{
+				program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
+				return 3;
+			}
+
+			CHISL_STRING name = command.get_arg("var").to_string();
+			program.get_scope().set(name, texts.value());
+
+			program.get_scope().set_constant(CONSTANT_OUTPUT, texts.value());
+
+			return 0;
+		}) },
+	{ CHISL_KEYWORD_LEARN, CommandTemplate(CHISL_KEYWORD_LEARN,
+		"learn " INPUT_PATTERN_VARIABLE " from " INPUT_PATTERN_VARIABLE " with " INPUT_PATTERN_STRING "\\.\\s*$",
+		{
+		{ 0, "name", CHISL_TYPE_VARIABLE },
+		{ 1, "image", CHISL_TYPE_VARIABLE },
+		{ 2, "characters", CHISL_TYPE_STRING }
+		},
+		[](Command const& command, Program& program) {
+			CHISL_STRING name = command.get_arg("name").to_string();
+			if (get_text_profile(name).has_value())
+			{
+				std::cerr << "Cannot learn glyphs as \"" << name << "\", as it is already a text profile.\n";
+				program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
+				return 1;
+			}
+
+			std::optional<Image> image = program.try_get_arg<Image>(command, "image");
+			if (!image.has_value())
+			{
+				program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
+				return 2;
+			}
+
+			CHISL_STRING characters = program.get_string(command, "characters");
+			std::optional<GlyphSet> glyphSet = learn_glyphs(image.value(), characters);
+			if (!glyphSet.has_value())
+			{
+				program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
+				return 3;
+			}
+
+			GlyphSetLibrary::get_instance().set(name, glyphSet.value());
+
+			program.get_scope().set_constant(CONSTANT_OUTPUT, static_cast<CHISL_INT>(glyphSet.value().glyphs.size()));
+
 			return 0;
 		}) },
 	{ CHISL_KEYWORD_DRAW, CommandTemplate(CHISL_KEYWORD_DRAW,
@@ -3541,6 +8150,14 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 				return 2;
 			}
 
+			// loaded images share their pixels with every other load of the same file,
+			// and background commands may still be reading the pixels, so draw on a copy of them
+			if (image.value().is_shared())
+			{
+				image = image.value().clone();
+				program.get_scope().set(command.get_arg("image").to_string(), image.value());
+			}
+
 			draw(image.value(), match.value());
 
 			return 0;
@@ -4217,8 +8834,106 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 			return 0;
 		}) },
 
+	{ CHISL_KEYWORD_ASYNC, CommandTemplate(CHISL_KEYWORD_ASYNC,
+		"async " INPUT_PATTERN_ANY "\\.\\s*$",
+		{
+		{ 0, "command", CHISL_TYPE_ANY }
+		},
+		[](Command const& command, Program& program) {
+			// parse the command after "async"
+			CHISL_STRING text = string_trim(command.get_text());
+			text = string_trim(text.substr(text.find(' ')));
+
+			Command inner = Program::parse_command(command.get_row(), text);
+			if (!inner.valid())
+			{
+				program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
+				return 1;
+			}
+
+			switch (inner.get_token())
+			{
+			case CHISL_KEYWORD_FIND:
+			case CHISL_KEYWORD_FIND_WITH:
+			case CHISL_KEYWORD_FIND_ALL:
+			case CHISL_KEYWORD_FIND_ALL_WITH:
+			case CHISL_KEYWORD_FIND_TEXT:
+			case CHISL_KEYWORD_FIND_TEXT_WITH:
+			case CHISL_KEYWORD_FIND_ALL_TEXT:
+			case CHISL_KEYWORD_FIND_ALL_TEXT_WITH:
+			case CHISL_KEYWORD_FIND_ANY:
+			case CHISL_KEYWORD_FIND_ANY_WITH:
+			case CHISL_KEYWORD_FIND_EACH:
+			case CHISL_KEYWORD_FIND_EACH_WITH:
+			case CHISL_KEYWORD_FIND_AT:
+			case CHISL_KEYWORD_FIND_AT_WITH:
+			case CHISL_KEYWORD_FIND_ALL_AT:
+			case CHISL_KEYWORD_FIND_ALL_AT_WITH:
+			case CHISL_KEYWORD_FIND_WITHIN:
+			case CHISL_KEYWORD_FIND_WITHIN_WITH:
+			case CHISL_KEYWORD_FIND_ALL_WITHIN:
+			case CHISL_KEYWORD_FIND_ALL_WITHIN_WITH:
+			case CHISL_KEYWORD_READ:
+			case CHISL_KEYWORD_READ_ALL:
+				break;
+			default:
+				std::cerr << "Cannot run \"" << text << "\" asynchronously.\n";
+				program.get_scope().set_constant(CONSTANT_OUTPUT, nullptr);
+				return 2;
+			}
+
+			CHISL_STRING name = inner.get_arg("var").to_string();
+
+			// the command runs on a copy of the program, so the script can keep changing its own variables meanwhile
+			std::shared_ptr<Program> worker = std::make_shared<Program>();
+			worker->get_scope() = program.get_scope();
+			worker->get_config() = program.get_config();
+
+			// the images the command reads are copied before they are drawn on, until it is done with them
+			std::vector<Image> reading;
+			for (Token const& arg : inner.get_args())
+			{
+				std::optional<Image> image = program.get_scope().peek_image(arg.to_string());
+				if (image.has_value())
+				{
+					image.value().add_reader();
+					reading.push_back(image.value());
+				}
+			}
+
+			std::shared_ptr<PendingState> state = std::make_shared<PendingState>();
+			state->future = ThreadPool::get_instance().submit<Value>([worker, inner, name, reading]() {
+				worker->execute(inner);
+				for (Image const& image : reading)
+				{
+					image.remove_reader();
+				}
+				return worker->get_scope().get(name);
+				});
+
+			Pending pending(state);
+			program.get_scope().set(name, pending);
+
+			program.get_scope().set_constant(CONSTANT_OUTPUT, pending);
+
+			return 0;
+		}) },
+	{ CHISL_KEYWORD_AWAIT, CommandTemplate(CHISL_KEYWORD_AWAIT,
+		"await " INPUT_PATTERN_VARIABLE "\\.\\s*$",
+		{
+		{ 0, "var", CHISL_TYPE_VARIABLE }
+		},
+		[](Command const& command, Program& program) {
+			// getting the value waits for it
+			Value value = program.get_scope().get(command.get_arg("var").to_string());
+
+			program.get_scope().set_constant(CONSTANT_OUTPUT, value);
+
+			return 0;
+		}) },
+
 	{ CHISL_KEYWORD_CONFIGURE, CommandTemplate(CHISL_KEYWORD_CONFIGURE,
-		"configure " INPUT_PATTERN_VARIABLE " to " INPUT_PATTERN_VARIABLE "\\.\\s*$",
+		"configure " INPUT_PATTERN_VARIABLE " to " INPUT_PATTERN_NUMBER "\\.\\s*$",
 		{
 		{ 0, "setting", CHISL_TYPE_KEY },
 		{ 1, "value", CHISL_TYPE_KEY }
@@ -4228,7 +8943,29 @@ std::unordered_map<ChislToken, CommandTemplate> Program::s_commandTemplates =
 			CHISL_STRING setting = command.get_arg("setting").to_string();
 			CHISL_STRING value = program.get_string(command, "value");
 
-			return program.get_config().set(setting, value);
+			int result = program.get_config().set(setting, value);
+
+			if (result == 0 && setting == "findThreads")
+			{
+				int threads = program.get_config().find.threads;
+				cv::setNumThreads(threads > 0 ? threads : -1);
+			}
+
+			// load the engines now, so the text commands do not have to, and free any that are no longer wanted
+			if (result == 0 && (setting == "textEngines" || setting == "textProfile"))
+			{
+				ReadOptions const& options = program.get_config().read;
+
+				// glyph sets do not use an engine
+				std::optional<TextProfile> profile = get_text_profile(options.profile);
+				if (profile.has_value())
+				{
+					TextEnginePool::get_instance().trim(options.profile, options.engines);
+					TextEnginePool::get_instance().warm(options.profile, profile.value(), options.engines);
+				}
+			}
+
+			return result;
 		}) },
 
 	{ CHISL_KEYWORD_TEST, CommandTemplate(CHISL_KEYWORD_TEST,
@@ -4322,6 +9059,19 @@ int main(int argc, char* argv[])
 
 	Program program = Program::from_file(argv[1]);
 
+	// start loading the OCR engine while the program starts running, so the first text command only waits for what is left
+	std::vector<std::future<void>> warming;
+	std::optional<CHISL_STRING> textProfile = program.get_first_text_profile();
+	if (textProfile.has_value())
+	{
+		warming = TextEnginePool::get_instance().warm_async(textProfile.value(), get_text_profile(textProfile.value()).value(), 1);
+	}
+
 	// run program
-	return program.run();
+	CHISL_INT result = program.run();
+
+	// let any async commands finish before the program closes
+	ThreadPool::get_instance().wait();
+
+	return result;
 }
\ No newline at end of file